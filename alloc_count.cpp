@@ -0,0 +1,28 @@
+#include <cstdlib>
+#include <new>
+
+#include "alloc_count.hpp"
+
+#ifdef COUNT_ALLOCATIONS
+
+namespace {
+thread_local uint64_t allocations = 0;
+}
+
+// the array and nothrow forms call these; nothing here uses over-aligned new
+void *operator new(std::size_t bytes) {
+    ++allocations;
+    if (void *p = std::malloc(bytes ? bytes : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+uint64_t thread_allocations() { return allocations; }
+
+#else
+
+uint64_t thread_allocations() { return 0; }
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef _ALLOC_COUNT_HPP
+#define _ALLOC_COUNT_HPP
+
+#include <cstdint>
+
+/* Heap allocation counting for checking that hot paths never allocate.
+   Building alloc_count.cpp with -DCOUNT_ALLOCATIONS replaces the global
+   operator new with one that counts calls per thread; without it nothing is
+   replaced and the count stays 0. */
+
+#ifdef COUNT_ALLOCATIONS
+#define ALLOCATION_COUNTING 1
+#else
+#define ALLOCATION_COUNTING 0
+#endif
+
+// operator new calls made by the calling thread so far
+uint64_t thread_allocations();
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef _CARDS_HPP
+#define _CARDS_HPP
+
+#include <cstdint>
+#include <utility>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+/* Bitmask card model shared by gto.cpp and poker.cpp.
+
+   A card is its bit index suit * 16 + rank, with rank 0 (deuce) to 12 (ace).
+   Each suit owns a 16-bit lane, so one shift pulls out a suit's rank mask.
+   Hands, boards and dead cards are CardMasks. Card structs are only used for
+   printing. */
+
+typedef uint64_t CardMask;
+
+const CardMask FULL_DECK = 0x1FFF1FFF1FFF1FFFULL;
+
+inline int card_index(int rank, int suit) { return suit * 16 + rank; }
+inline int card_rank(int card) { return card & 15; }
+inline int card_suit(int card) { return card >> 4; }
+inline CardMask card_mask(int card) { return 1ULL << card; }
+
+inline int num_cards(CardMask cards) { return __builtin_popcountll(cards); }
+inline uint32_t suit_ranks(CardMask cards, int suit) { return (cards >> (suit * 16)) & 0x1FFF; }
+inline uint32_t rank_set(CardMask cards) {
+    return (cards | cards >> 16 | cards >> 32 | cards >> 48) & 0x1FFF;
+}
+
+// removes and returns the lowest card of the mask
+inline int pop_card(CardMask &cards) {
+    int card = __builtin_ctzll(cards);
+    cards &= cards - 1;
+    return card;
+}
+
+// the cards not in dead, lowest first; returns how many
+inline int live_cards(CardMask dead, int *cards) {
+    int size = 0;
+    for (CardMask live = FULL_DECK & ~dead; live;) cards[size++] = pop_card(live);
+    return size;
+}
+
+// uniform in [0, bound) by multiply-shift, from a generator of 64-bit words
+template <class Rng>
+inline uint32_t random_below(Rng &rng, uint32_t bound) {
+    static_assert(Rng::max() == UINT64_MAX && Rng::min() == 0, "needs a 64-bit generator");
+    return uint32_t((unsigned __int128)rng() * bound >> 64);
+}
+
+/* Partial Fisher-Yates: moves n of cards[0 .. size-1], drawn uniformly
+   without replacement, to the end of the array, the first drawn last, so
+   they come off the top of a deck drawn from the back. n swaps and n random
+   numbers, where a full shuffle would take size of each. Dead cards are kept
+   out by leaving them out of cards, see live_cards. */
+template <class Rng>
+inline void deal_to_top(int *cards, int size, int n, Rng &rng) {
+    for (int i = size - 1; i >= size - n; --i) std::swap(cards[i], cards[random_below(rng, i + 1)]);
+}
+
+// the nth lowest card of the mask, n < num_cards(cards)
+inline int nth_card(CardMask cards, int n) {
+#ifdef __BMI2__
+    return __builtin_ctzll(_pdep_u64(1ULL << n, cards));
+#else
+    while (n--) cards &= cards - 1;
+    return __builtin_ctzll(cards);
+#endif
+}
+
+#endif
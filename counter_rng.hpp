@@ -0,0 +1,48 @@
+#ifndef _COUNTER_RNG_HPP
+#define _COUNTER_RNG_HPP
+
+#include <cstdint>
+
+/* Counter-based random numbers shared by gto.cpp and poker.cpp.
+
+   Output n of a generator is splitmix64(key + n * golden gamma), i.e. the
+   SplitMix64 sequence started at key, so a generator is a key and a counter:
+   a few multiplies per number, free to copy, and any output can be recomputed
+   from its index. seed(seed, stream) derives the key from a seed and a stream
+   index (a thread, a table, a deal), which gives parallel work a stream of its
+   own that depends only on the seed and the index, never on scheduling. */
+
+const uint64_t GOLDEN_GAMMA = 0x9E3779B97F4A7C15ULL;
+
+// SplitMix64 finaliser of x + golden gamma
+inline uint64_t splitmix64(uint64_t x) {
+    x += GOLDEN_GAMMA;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// a UniformRandomBitGenerator, so it works with std::shuffle and <random>'s distributions
+class CounterRng {
+public:
+    typedef uint64_t result_type;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    explicit CounterRng(uint64_t seed = 0, uint64_t stream = 0) { this->seed(seed, stream); }
+
+    void seed(uint64_t seed, uint64_t stream = 0) {
+        key = splitmix64(seed ^ splitmix64(~stream));
+        counter = 0;
+    }
+
+    result_type operator()() { return splitmix64(key + counter++ * GOLDEN_GAMMA); }
+
+    void discard(uint64_t n) { counter += n; }
+
+private:
+    uint64_t key;
+    uint64_t counter;
+};
+
+#endif
@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <cmath>
+
+#include "counter_rng.hpp"
+#include "equity.hpp"
+#include "evaluator.hpp"
+
+namespace {
+
+constexpr int MAX_RANGE = 1326;
+constexpr int BATCH = 64;
+
+// inverse powers of the plastic number, the R2 sequence steps
+constexpr double R2_STEP1 = 0.7548776662466927;
+constexpr double R2_STEP2 = 0.5698402909980532;
+
+struct Binomials {
+    int c[53][6];
+    Binomials() {
+        for (int n = 0; n <= 52; ++n) {
+            c[n][0] = 1;
+            for (int k = 1; k <= 5; ++k) c[n][k] = n == 0 ? 0 : c[n - 1][k - 1] + c[n - 1][k];
+        }
+    }
+} binomials;
+
+double to_unit(uint64_t x) { return (x >> 11) * (1.0 / 9007199254740992.0); }
+
+float outcome(int hero_score, int villain_score) {
+    if (hero_score > villain_score) return 1.0f;
+    if (hero_score == villain_score) return 0.5f;
+    return 0.0f;
+}
+
+// the index-th (colex) k-card subset of the live cards
+CardMask unrank_runout(CardMask live, int k, int index) {
+    CardMask runout = 0;
+    int top = num_cards(live);
+    for (int i = k; i > 0; --i) {
+        int c = i - 1;
+        while (c + 1 < top && binomials.c[c + 1][i] <= index) ++c;
+        index -= binomials.c[c][i];
+        runout |= card_mask(nth_card(live, c));
+        top = c;
+    }
+    return runout;
+}
+
+EquityResult exact_equity(CardMask hero, CardMask board, const CardMask *villains, const float *weights, int n) {
+    CardMask hands[MAX_RANGE];
+    int scores[MAX_RANGE];
+    double total = 0;
+    double weight_sum = 0;
+    for (int v = 0; v < n; ++v) weight_sum += weights[v];
+
+    if (num_cards(board) == 5) {
+        int hero_score = evaluate_hand(hero | board);
+        evaluate_hands(villains, board, scores, n);
+        for (int v = 0; v < n; ++v) total += weights[v] * outcome(hero_score, scores[v]);
+        return {float(total / weight_sum), 0.0f, n};
+    }
+
+    // turn: every villain sees the same number of rivers
+    CardMask rivers = FULL_DECK & ~(hero | board);
+    int rivers_per_villain = num_cards(rivers) - 2;
+    int scored = 0;
+    while (rivers) {
+        CardMask river = card_mask(pop_card(rivers));
+        int hero_score = evaluate_hand(hero | board | river);
+        int m = 0;
+        float live_weights[MAX_RANGE];
+        for (int v = 0; v < n; ++v) {
+            if (villains[v] & river) continue;
+            hands[m] = villains[v];
+            live_weights[m++] = weights[v];
+        }
+        evaluate_hands(hands, board | river, scores, m);
+        for (int v = 0; v < m; ++v) total += live_weights[v] * outcome(hero_score, scores[v]);
+        scored += m;
+    }
+    return {float(total / (weight_sum * rivers_per_villain)), 0.0f, scored};
+}
+
+EquityResult sampled_equity(CardMask hero, CardMask board, const CardMask *villains, const float *weights, int n,
+                            uint64_t seed, int samples) {
+    float cumulative[MAX_RANGE];
+    float weight_sum = 0;
+    for (int v = 0; v < n; ++v) {
+        weight_sum += weights[v];
+        cumulative[v] = weight_sum;
+    }
+    CardMask dead = hero | board;
+    int k = 5 - num_cards(board);
+    int runouts = binomials.c[52 - num_cards(dead) - 2][k];
+
+    double u1 = to_unit(splitmix64(seed));
+    double u2 = to_unit(splitmix64(seed ^ 0x5851F42D4C957F2DULL));
+    double sum = 0;
+    double sum_sq = 0;
+    CardMask hero_hands[BATCH], villain_hands[BATCH];
+    int hero_scores[BATCH], villain_scores[BATCH];
+    for (int done = 0; done < samples; done += BATCH) {
+        int batch = std::min(BATCH, samples - done);
+        for (int i = 0; i < batch; ++i) {
+            int v = std::upper_bound(cumulative, cumulative + n, float(u1 * weight_sum)) - cumulative;
+            CardMask villain = villains[std::min(v, n - 1)];
+            int index = std::min(int(u2 * runouts), runouts - 1);
+            CardMask runout = unrank_runout(FULL_DECK & ~(dead | villain), k, index);
+            hero_hands[i] = hero | board | runout;
+            villain_hands[i] = villain | board | runout;
+            u1 += R2_STEP1;
+            if (u1 >= 1.0) u1 -= 1.0;
+            u2 += R2_STEP2;
+            if (u2 >= 1.0) u2 -= 1.0;
+        }
+        evaluate_hands(hero_hands, hero_scores, batch);
+        evaluate_hands(villain_hands, villain_scores, batch);
+        for (int i = 0; i < batch; ++i) {
+            float o = outcome(hero_scores[i], villain_scores[i]);
+            sum += o;
+            sum_sq += o * o;
+        }
+    }
+    double mean = sum / samples;
+    double variance = std::max(0.0, sum_sq / samples - mean * mean);
+    return {float(mean), float(1.96 * std::sqrt(variance / samples)), samples};
+}
+
+// a range with the hands that touch the board taken out
+struct LiveRange {
+    CardMask villains[MAX_RANGE];
+    float weights[MAX_RANGE];
+    float cumulative[MAX_RANGE];
+    int n;
+};
+
+void exact_equities(const CardMask *heroes, int num_heroes, CardMask board, const LiveRange *ranges,
+                    int num_ranges, EquityResult *results) {
+    static thread_local CardMask live[MAX_RANGE];
+    static thread_local float live_weights[MAX_RANGE];
+    static thread_local int scores[MAX_RANGE];
+    double total[MAX_HEROES * MAX_RANGES] = {};
+    double weight_sum[MAX_HEROES * MAX_RANGES] = {};
+    int scored[MAX_HEROES * MAX_RANGES] = {};
+    int hero_scores[MAX_HEROES];
+    for (int h = 0; h < num_heroes; ++h) {
+        for (int r = 0; r < num_ranges; ++r) {
+            for (int v = 0; v < ranges[r].n; ++v) {
+                if (!(ranges[r].villains[v] & heroes[h])) weight_sum[h * num_ranges + r] += ranges[r].weights[v];
+            }
+        }
+    }
+
+    // on the river the loop runs once with an empty runout
+    bool river = num_cards(board) == 5;
+    CardMask rivers = river ? 0 : FULL_DECK & ~board;
+    do {
+        CardMask runout = river ? 0 : card_mask(pop_card(rivers));
+        evaluate_hands(heroes, board | runout, hero_scores, num_heroes);
+        for (int r = 0; r < num_ranges; ++r) {
+            int m = 0;
+            for (int v = 0; v < ranges[r].n; ++v) {
+                if (ranges[r].villains[v] & runout) continue;
+                live[m] = ranges[r].villains[v];
+                live_weights[m++] = ranges[r].weights[v];
+            }
+            evaluate_hands(live, board | runout, scores, m);
+            for (int h = 0; h < num_heroes; ++h) {
+                if (heroes[h] & runout) continue;
+                int i = h * num_ranges + r;
+                for (int v = 0; v < m; ++v) {
+                    if (live[v] & heroes[h]) continue;
+                    total[i] += live_weights[v] * outcome(hero_scores[h], scores[v]);
+                    scored[i]++;
+                }
+            }
+        }
+    } while (rivers);
+
+    for (int h = 0; h < num_heroes; ++h) {
+        // every villain sees the same number of rivers
+        int runouts_per_villain = river ? 1 : num_cards(FULL_DECK & ~(heroes[h] | board)) - 2;
+        for (int r = 0; r < num_ranges; ++r) {
+            int i = h * num_ranges + r;
+            if (weight_sum[i] <= 0) results[i] = {0.5f, 0.5f, 0};
+            else results[i] = {float(total[i] / (weight_sum[i] * runouts_per_villain)), 0.0f, scored[i]};
+        }
+    }
+}
+
+void sampled_equities(const CardMask *heroes, int num_heroes, CardMask board, const LiveRange *ranges,
+                      int num_ranges, uint64_t seed, int samples, EquityResult *results) {
+    CardMask live = FULL_DECK & ~board;
+    int k = 5 - num_cards(board);
+    int runouts = binomials.c[num_cards(live)][k];
+
+    double u1 = to_unit(splitmix64(seed));
+    double u2 = to_unit(splitmix64(seed ^ 0x5851F42D4C957F2DULL));
+    double sum[MAX_HEROES * MAX_RANGES] = {};
+    double sum_sq[MAX_HEROES * MAX_RANGES] = {};
+    int count[MAX_HEROES * MAX_RANGES] = {};
+    CardMask runout[BATCH];
+    CardMask hero_hands[MAX_HEROES][BATCH], villains[MAX_RANGES][BATCH], villain_hands[MAX_RANGES][BATCH];
+    int hero_scores[MAX_HEROES][BATCH], villain_scores[MAX_RANGES][BATCH];
+    for (int done = 0; done < samples; done += BATCH) {
+        int batch = std::min(BATCH, samples - done);
+        for (int i = 0; i < batch; ++i) {
+            runout[i] = unrank_runout(live, k, std::min(int(u2 * runouts), runouts - 1));
+            for (int h = 0; h < num_heroes; ++h) hero_hands[h][i] = heroes[h] | runout[i];
+            for (int r = 0; r < num_ranges; ++r) {
+                const LiveRange &range = ranges[r];
+                int v = 0;
+                if (range.n > 0) {
+                    float target = float(u1 * range.cumulative[range.n - 1]);
+                    v = std::upper_bound(range.cumulative, range.cumulative + range.n, target) - range.cumulative;
+                    v = std::min(v, range.n - 1);
+                }
+                villains[r][i] = range.n > 0 ? range.villains[v] : runout[i];
+                villain_hands[r][i] = villains[r][i] | runout[i];
+            }
+            u1 += R2_STEP1;
+            if (u1 >= 1.0) u1 -= 1.0;
+            u2 += R2_STEP2;
+            if (u2 >= 1.0) u2 -= 1.0;
+        }
+        for (int h = 0; h < num_heroes; ++h) evaluate_hands(hero_hands[h], board, hero_scores[h], batch);
+        for (int r = 0; r < num_ranges; ++r) evaluate_hands(villain_hands[r], board, villain_scores[r], batch);
+        for (int i = 0; i < batch; ++i) {
+            for (int r = 0; r < num_ranges; ++r) {
+                // an empty range's villain is the runout itself, which always collides
+                if (villains[r][i] & runout[i]) continue;
+                for (int h = 0; h < num_heroes; ++h) {
+                    if (heroes[h] & (runout[i] | villains[r][i])) continue;
+                    float o = outcome(hero_scores[h][i], villain_scores[r][i]);
+                    int j = h * num_ranges + r;
+                    sum[j] += o;
+                    sum_sq[j] += o * o;
+                    count[j]++;
+                }
+            }
+        }
+    }
+    for (int j = 0; j < num_heroes * num_ranges; ++j) {
+        if (count[j] == 0) {
+            results[j] = {0.5f, 0.5f, 0};
+            continue;
+        }
+        double mean = sum[j] / count[j];
+        double variance = std::max(0.0, sum_sq[j] / count[j] - mean * mean);
+        results[j] = {float(mean), float(1.96 * std::sqrt(variance / count[j])), count[j]};
+    }
+}
+
+} // namespace
+
+EquityResult calculate_equity(CardMask hero, CardMask board, const std::vector<WeightedHand> &range,
+                              uint64_t seed, int samples) {
+    CardMask villains[MAX_RANGE];
+    float weights[MAX_RANGE];
+    int n = 0;
+    for (const WeightedHand &h: range) {
+        if ((h.cards & (hero | board)) || h.weight <= 0) continue;
+        villains[n] = h.cards;
+        weights[n++] = h.weight;
+    }
+    if (n == 0) return {0.5f, 0.5f, 0};
+
+    if (num_cards(board) >= 4) return exact_equity(hero, board, villains, weights, n);
+    return sampled_equity(hero, board, villains, weights, n, seed, samples);
+}
+
+void calculate_equities(const CardMask *heroes, int num_heroes, CardMask board,
+                        const std::vector<WeightedHand> *ranges, int num_ranges,
+                        uint64_t seed, EquityResult *results, int samples) {
+    static thread_local LiveRange live[MAX_RANGES];
+    for (int r = 0; r < num_ranges; ++r) {
+        LiveRange &range = live[r];
+        range.n = 0;
+        float weight_sum = 0;
+        for (const WeightedHand &h: ranges[r]) {
+            if ((h.cards & board) || h.weight <= 0) continue;
+            weight_sum += h.weight;
+            range.villains[range.n] = h.cards;
+            range.weights[range.n] = h.weight;
+            range.cumulative[range.n++] = weight_sum;
+        }
+    }
+    if (num_cards(board) >= 4) exact_equities(heroes, num_heroes, board, live, num_ranges, results);
+    else sampled_equities(heroes, num_heroes, board, live, num_ranges, seed, samples, results);
+}
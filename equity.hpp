@@ -0,0 +1,47 @@
+#ifndef _EQUITY_HPP
+#define _EQUITY_HPP
+
+#include <vector>
+
+#include "cards.hpp"
+
+/* Hero-vs-range equity.
+
+   On the turn and river every remaining runout and every live villain hand is
+   enumerated, so the result is exact. On the flop and preflop (villain, runout)
+   pairs are drawn from a randomly shifted R2 low-discrepancy sequence. Villains
+   are picked in proportion to their weight, and the runout is unranked from the
+   cards left in the deck. Hands are scored in batches. */
+
+struct WeightedHand {
+    CardMask cards;
+    float weight;
+};
+
+struct EquityResult {
+    float equity;      // ties count half
+    float error_bound; // 95% half-width, 0 when exact
+    int samples;       // (villain, runout) pairs scored
+};
+
+// default (villain, runout) budget on the flop and preflop
+#define EQUITY_SAMPLES 1024
+
+// range holds distinct hands (at most 1326). seed randomises the sequence shift;
+// villains touching hero or board are skipped
+EquityResult calculate_equity(CardMask hero, CardMask board, const std::vector<WeightedHand> &range,
+                              uint64_t seed, int samples = EQUITY_SAMPLES);
+
+/* Every hero against every range on one board, results[hero * num_ranges +
+   range]. Runouts are drawn once for the whole table and each range draws one
+   villain per runout, so a runout costs one evaluation per hero and one per
+   range. A hero only counts the pairs that miss its own cards, which leaves
+   each hero's estimate distributed as in calculate_equity; the turn and river
+   are still exact. */
+#define MAX_HEROES 8
+#define MAX_RANGES 8
+void calculate_equities(const CardMask *heroes, int num_heroes, CardMask board,
+                        const std::vector<WeightedHand> *ranges, int num_ranges,
+                        uint64_t seed, EquityResult *results, int samples = EQUITY_SAMPLES);
+
+#endif
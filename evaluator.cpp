@@ -0,0 +1,344 @@
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_AVX2_PATH 1
+#endif
+
+#include "evaluator.hpp"
+#include "instrument.hpp"
+
+namespace {
+
+constexpr int NUM_RANKS = 13;
+constexpr int MAX_CARDS = 7;
+constexpr int MAX_BOARD = 5;
+// sum over n = 0..7 of C(12 + n, n) rank multisets
+constexpr int RANK_TABLE_SIZE = 77520;
+// sum over n = 0..5 of C(12 + n, n) board rank multisets
+constexpr int NUM_BOARD_MULTISETS = 8568;
+
+uint32_t binom[NUM_RANKS + MAX_CARDS + 1][MAX_CARDS + 2];
+// colex contribution of c copies of rank r placed after p lower cards
+uint32_t rank_term[NUM_RANKS][MAX_CARDS + 1][MAX_CARDS + 1];
+// start of the n-card block in rank_table
+uint32_t rank_offset[MAX_CARDS + 1];
+
+int rank_table[RANK_TABLE_SIZE];
+int flush_table[1 << NUM_RANKS];
+// for every board rank multiset, the rank-only scores of all 91 hole rank
+// combos added to it, sorted ascending
+int combo_table[NUM_BOARD_MULTISETS][NUM_RANK_COMBOS];
+
+int pack_kickers(int category, const int *ranks, int n) {
+    int score = category;
+    for (int i = 0; i < 5; ++i) {
+        score = (score << 4) | (i < n ? ranks[i] + 1 : 0);
+    }
+    return score;
+}
+
+// highest rank of a 5-long run in the mask, -1 if none. The wheel counts as 5-high.
+int straight_high(uint32_t mask) {
+    for (int high = 12; high >= 4; --high) {
+        uint32_t run = 0x1Fu << (high - 4);
+        if ((mask & run) == run) return high;
+    }
+    uint32_t wheel = (1u << 12) | 0xFu;
+    if ((mask & wheel) == wheel) return 3;
+    return -1;
+}
+
+int score_flush(uint32_t mask) {
+    int high = straight_high(mask);
+    if (high != -1) return pack_kickers(STRAIGHT_FLUSH, &high, 1);
+    int ranks[5];
+    int n = 0;
+    for (int r = NUM_RANKS - 1; r >= 0 && n < 5; --r) {
+        if (mask >> r & 1) ranks[n++] = r;
+    }
+    return pack_kickers(FLUSH, ranks, n);
+}
+
+// slow reference scoring of a rank multiset, only used to fill rank_table
+int score_counts(const int *count) {
+    int quads = -1;
+    int trips[2], num_trips = 0;
+    int pairs[3], num_pairs = 0;
+    uint32_t present = 0;
+    for (int r = NUM_RANKS - 1; r >= 0; --r) {
+        if (count[r] > 4) return 0;
+        if (count[r] > 0) present |= 1u << r;
+        if (count[r] == 4) quads = r;
+        else if (count[r] == 3) trips[num_trips++] = r;
+        else if (count[r] == 2) pairs[num_pairs++] = r;
+    }
+
+    // fill kickers[] with the highest ranks not in the excluded mask
+    int kickers[5];
+    auto take = [&](int start, uint32_t excluded, int limit) {
+        int n = start;
+        for (int r = NUM_RANKS - 1; r >= 0 && n < limit; --r) {
+            if ((present >> r & 1) && !(excluded >> r & 1)) kickers[n++] = r;
+        }
+        return n;
+    };
+
+    if (quads != -1) {
+        kickers[0] = quads;
+        return pack_kickers(FOUR_OF_A_KIND, kickers, take(1, 1u << quads, 2));
+    }
+    if (num_trips > 0 && (num_trips > 1 || num_pairs > 0)) {
+        kickers[0] = trips[0];
+        kickers[1] = num_trips > 1 ? trips[1] : pairs[0];
+        if (num_trips > 1 && num_pairs > 0 && pairs[0] > trips[1]) kickers[1] = pairs[0];
+        return pack_kickers(FULL_HOUSE, kickers, 2);
+    }
+    int high = straight_high(present);
+    if (high != -1) return pack_kickers(STRAIGHT, &high, 1);
+    if (num_trips > 0) {
+        kickers[0] = trips[0];
+        return pack_kickers(THREE_OF_A_KIND, kickers, take(1, 1u << trips[0], 3));
+    }
+    if (num_pairs > 1) {
+        kickers[0] = pairs[0];
+        kickers[1] = pairs[1];
+        return pack_kickers(TWO_PAIR, kickers, take(2, (1u << pairs[0]) | (1u << pairs[1]), 3));
+    }
+    if (num_pairs == 1) {
+        kickers[0] = pairs[0];
+        return pack_kickers(ONE_PAIR, kickers, take(1, 1u << pairs[0], 4));
+    }
+    return pack_kickers(HIGH_CARD, kickers, take(0, 0, 5));
+}
+
+// colex rank of the multiset among all multisets of the same size
+uint32_t multiset_index(const int *count, int &n) {
+    uint32_t index = 0;
+    n = 0;
+    for (int r = 0; r < NUM_RANKS; ++r) {
+        if (count[r] == 0) continue;
+        index += rank_term[r][n][count[r]];
+        n += count[r];
+    }
+    return index;
+}
+
+void fill_rank_table(int *count, int rank, int remaining) {
+    if (rank == NUM_RANKS) {
+        int n;
+        uint32_t index = multiset_index(count, n);
+        rank_table[rank_offset[n] + index] = score_counts(count);
+        return;
+    }
+    for (int c = 0; c <= remaining; ++c) {
+        count[rank] = c;
+        fill_rank_table(count, rank + 1, remaining - c);
+    }
+    count[rank] = 0;
+}
+
+void fill_combo_table(int *count, int rank, int remaining) {
+    if (rank == NUM_RANKS) {
+        int n;
+        uint32_t board_index = multiset_index(count, n);
+        int *row = combo_table[rank_offset[n] + board_index];
+        int combo = 0;
+        for (int high = 0; high < NUM_RANKS; ++high) {
+            for (int low = 0; low <= high; ++low) {
+                count[high]++;
+                count[low]++;
+                uint32_t index = multiset_index(count, n);
+                row[combo++] = rank_table[rank_offset[n] + index];
+                count[high]--;
+                count[low]--;
+            }
+        }
+        std::sort(row, row + NUM_RANK_COMBOS);
+        return;
+    }
+    for (int c = 0; c <= remaining; ++c) {
+        count[rank] = c;
+        fill_combo_table(count, rank + 1, remaining - c);
+    }
+    count[rank] = 0;
+}
+
+// colex rank of the cards' rank multiset; n gets the number of cards
+uint32_t mask_index(const uint32_t *suits, int &n) {
+    uint32_t present = suits[0] | suits[1] | suits[2] | suits[3];
+    uint32_t index = 0;
+    n = 0;
+    while (present) {
+        int r = __builtin_ctz(present);
+        present &= present - 1;
+        int c = (suits[0] >> r & 1) + (suits[1] >> r & 1) + (suits[2] >> r & 1) + (suits[3] >> r & 1);
+        index += rank_term[r][n][c];
+        n += c;
+    }
+    return index;
+}
+
+struct TableBuilder {
+    TableBuilder() {
+        for (int n = 0; n <= NUM_RANKS + MAX_CARDS; ++n) {
+            binom[n][0] = 1;
+            for (int k = 1; k <= MAX_CARDS + 1; ++k) {
+                binom[n][k] = n == 0 ? 0 : binom[n - 1][k - 1] + binom[n - 1][k];
+            }
+        }
+        for (int r = 0; r < NUM_RANKS; ++r) {
+            for (int p = 0; p <= MAX_CARDS; ++p) {
+                uint32_t term = 0;
+                rank_term[r][p][0] = 0;
+                for (int c = 1; p + c <= MAX_CARDS; ++c) {
+                    // the (p + c)th smallest card maps to element r + p + c - 1
+                    term += binom[r + p + c - 1][p + c];
+                    rank_term[r][p][c] = term;
+                }
+            }
+        }
+        uint32_t offset = 0;
+        for (int n = 0; n <= MAX_CARDS; ++n) {
+            rank_offset[n] = offset;
+            offset += binom[NUM_RANKS - 1 + n][n];
+        }
+
+        int count[NUM_RANKS] = {};
+        fill_rank_table(count, 0, MAX_CARDS);
+        for (uint32_t mask = 0; mask < (1u << NUM_RANKS); ++mask) {
+            flush_table[mask] = __builtin_popcount(mask) >= 5 ? score_flush(mask) : 0;
+        }
+        fill_combo_table(count, 0, MAX_BOARD);
+    }
+} table_builder;
+
+#ifdef HAVE_AVX2_PATH
+
+/* Eight hands in 32-bit lanes. The rank multiset index is built the same way
+   as mask_index, one rank at a time for all lanes: the rank's count across the
+   four suits picks rank_term[r][placed][count] with a gather. A lane with five
+   or more cards in a suit takes flush_table instead. */
+__attribute__((target("avx2")))
+inline __m256i popcount_lanes(__m256i v) {
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, nibble));
+    __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    __m256i bytes = _mm256_add_epi8(lo, hi);
+    return _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, _mm256_set1_epi8(1)), _mm256_set1_epi16(1));
+}
+
+__attribute__((target("avx2")))
+inline __m256i evaluate8(const CardMask *hands, CardMask common) {
+    __m256i shared = _mm256_set1_epi64x(common);
+    __m256i a = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(hands)), shared);
+    __m256i b = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(hands + 4)), shared);
+    // low and high 32 bits of every hand, back in hand order
+    __m256i low = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b),
+                                                        _MM_SHUFFLE(2, 0, 2, 0)));
+    __m256i high = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b),
+                                                         _MM_SHUFFLE(3, 1, 3, 1)));
+    low = _mm256_permute4x64_epi64(low, _MM_SHUFFLE(3, 1, 2, 0));
+    high = _mm256_permute4x64_epi64(high, _MM_SHUFFLE(3, 1, 2, 0));
+
+    const __m256i rank_bits = _mm256_set1_epi32(0x1FFF);
+    __m256i suits[4] = {
+        _mm256_and_si256(low, rank_bits), _mm256_and_si256(_mm256_srli_epi32(low, 16), rank_bits),
+        _mm256_and_si256(high, rank_bits), _mm256_and_si256(_mm256_srli_epi32(high, 16), rank_bits),
+    };
+
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i index = _mm256_setzero_si256();
+    __m256i placed = _mm256_setzero_si256();
+    __m256i s0 = suits[0], s1 = suits[1], s2 = suits[2], s3 = suits[3];
+    const int *terms = reinterpret_cast<const int *>(rank_term);
+    for (int r = 0; r < NUM_RANKS; ++r) {
+        __m256i count = _mm256_add_epi32(_mm256_add_epi32(_mm256_and_si256(s0, one), _mm256_and_si256(s1, one)),
+                                         _mm256_add_epi32(_mm256_and_si256(s2, one), _mm256_and_si256(s3, one)));
+        __m256i slot = _mm256_add_epi32(_mm256_slli_epi32(placed, 3), count);
+        index = _mm256_add_epi32(index, _mm256_i32gather_epi32(terms + r * 64, slot, 4));
+        placed = _mm256_add_epi32(placed, count);
+        s0 = _mm256_srli_epi32(s0, 1);
+        s1 = _mm256_srli_epi32(s1, 1);
+        s2 = _mm256_srli_epi32(s2, 1);
+        s3 = _mm256_srli_epi32(s3, 1);
+    }
+    __m256i offsets = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rank_offset));
+    index = _mm256_add_epi32(index, _mm256_permutevar8x32_epi32(offsets, placed));
+    __m256i scores = _mm256_i32gather_epi32(rank_table, index, 4);
+
+    // at most one suit of a 7-card hand can hold five cards
+    const __m256i four = _mm256_set1_epi32(4);
+    __m256i flush_ranks = _mm256_setzero_si256();
+    for (int s = 0; s < 4; ++s) {
+        __m256i is_flush = _mm256_cmpgt_epi32(popcount_lanes(suits[s]), four);
+        flush_ranks = _mm256_or_si256(flush_ranks, _mm256_and_si256(suits[s], is_flush));
+    }
+    __m256i has_flush = _mm256_cmpgt_epi32(flush_ranks, _mm256_setzero_si256());
+    return _mm256_mask_i32gather_epi32(scores, flush_table, flush_ranks, has_flush, 4);
+}
+
+// two independent 8-lane chains per step keep the gathers overlapped
+__attribute__((target("avx2")))
+int evaluate_hands_avx2(const CardMask *hands, CardMask common, int *scores, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i first = evaluate8(hands + i, common);
+        __m256i second = evaluate8(hands + i + 8, common);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(scores + i), first);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(scores + i + 8), second);
+    }
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(scores + i), evaluate8(hands + i, common));
+    }
+    return i;
+}
+
+const bool have_avx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}();
+
+#endif
+
+} // namespace
+
+int evaluate_hand(CardMask cards) {
+    count_event(HANDS_EVALUATED);
+    uint32_t suits[4];
+    for (int s = 0; s < 4; ++s) {
+        suits[s] = suit_ranks(cards, s);
+        if (__builtin_popcount(suits[s]) >= 5) return flush_table[suits[s]];
+    }
+    int n;
+    uint32_t index = mask_index(suits, n);
+    return rank_table[rank_offset[n] + index];
+}
+
+void evaluate_hands(const CardMask *hands, CardMask common, int *scores, int n) {
+    int i = 0;
+#ifdef HAVE_AVX2_PATH
+    if (have_avx2) i = evaluate_hands_avx2(hands, common, scores, n);
+    count_event(HANDS_EVALUATED, i);
+#endif
+    for (; i < n; ++i) scores[i] = evaluate_hand(hands[i] | common);
+}
+
+int evaluate_ranks(const int *ranks, int n) {
+    int count[NUM_RANKS] = {};
+    for (int i = 0; i < n; ++i) count[ranks[i]]++;
+    int placed;
+    uint32_t index = multiset_index(count, placed);
+    return rank_table[rank_offset[placed] + index];
+}
+
+int rank_combos_that_beat(CardMask board, int score) {
+    uint32_t suits[4];
+    for (int s = 0; s < 4; ++s) suits[s] = suit_ranks(board, s);
+    int n;
+    uint32_t index = mask_index(suits, n);
+    const int *row = combo_table[rank_offset[n] + index];
+    return row + NUM_RANK_COMBOS - std::upper_bound(row, row + NUM_RANK_COMBOS, score);
+}
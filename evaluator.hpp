@@ -0,0 +1,50 @@
+#ifndef _EVALUATOR_HPP
+#define _EVALUATOR_HPP
+
+#include "cards.hpp"
+
+/* Shared hand evaluator for gto.cpp and poker.cpp.
+
+   Hands are CardMasks (see cards.hpp). Scores compare directly (higher
+   wins): the hand category sits in bits 20 and up, followed by up to five
+   4-bit kickers holding rank + 1.
+
+   Flushes come from a table over the 13-bit rank mask of the suit. Everything
+   else comes from a table over the rank multiset, indexed by its colex rank,
+   so no call allocates or sorts. */
+
+enum HandCategory : int {
+    HIGH_CARD,
+    ONE_PAIR,
+    TWO_PAIR,
+    THREE_OF_A_KIND,
+    STRAIGHT,
+    FLUSH,
+    FULL_HOUSE,
+    FOUR_OF_A_KIND,
+    STRAIGHT_FLUSH
+};
+
+// (high, low) hole rank pairs, pocket pairs included
+#define NUM_RANK_COMBOS 91
+
+inline int hand_category(int score) { return score >> 20; }
+
+// 5 to 7 cards
+int evaluate_hand(CardMask cards);
+
+// scores[i] = evaluate_hand(hands[i] | common) for n hands, 5 to 7 cards each.
+// Runs 16 hands per step on AVX2 when the CPU has it (checked once at run
+// time), the scalar evaluator otherwise.
+void evaluate_hands(const CardMask *hands, CardMask common, int *scores, int n);
+inline void evaluate_hands(const CardMask *hands, int *scores, int n) { evaluate_hands(hands, 0, scores, n); }
+
+// 0 to 7 ranks, suits ignored (no flushes). Rank multisets that cannot occur
+// in a real deck (five of a kind) score 0.
+int evaluate_ranks(const int *ranks, int n);
+
+// how many of the 91 hole rank combos, played with the board's ranks and no
+// flushes, score higher than score. Boards of 0 to 5 cards, tables built at load.
+int rank_combos_that_beat(CardMask board, int score);
+
+#endif
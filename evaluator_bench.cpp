@@ -0,0 +1,59 @@
+// compile with g++ -std=c++17 -O2 -Wall evaluator_bench.cpp evaluator.cpp -o evaluator_bench
+// usage: ./evaluator_bench [hands]
+//
+// Hands per second of evaluate_hand one at a time and of the evaluate_hands
+// batch path on random 7-card hands, after checking the two agree.
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "evaluator.hpp"
+
+namespace {
+
+template <typename F>
+double hands_per_second(int n, int repeats, F run) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r) run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return double(n) * repeats / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 1 << 20;
+    std::mt19937_64 rng(12345);
+    std::vector<CardMask> hands(n);
+    for (CardMask &hand: hands) {
+        hand = 0;
+        while (num_cards(hand) < 7) hand |= card_mask(card_index(rng() % 13, rng() % 4));
+    }
+
+    std::vector<int> single(n), batch(n);
+    for (int i = 0; i < n; ++i) single[i] = evaluate_hand(hands[i]);
+    evaluate_hands(hands.data(), batch.data(), n);
+    for (int i = 0; i < n; ++i) {
+        if (single[i] != batch[i]) {
+            std::cerr << "mismatch at hand " << i << ": " << single[i] << " vs " << batch[i] << std::endl;
+            return 1;
+        }
+    }
+
+    const int repeats = 10;
+    long long checksum = 0;
+    double scalar = hands_per_second(n, repeats, [&]() {
+        for (int i = 0; i < n; ++i) single[i] = evaluate_hand(hands[i]);
+        checksum += single[n - 1];
+    });
+    double batched = hands_per_second(n, repeats, [&]() {
+        evaluate_hands(hands.data(), batch.data(), n);
+        checksum += batch[n - 1];
+    });
+    std::cout << "evaluate_hand:  " << scalar / 1e6 << " M hands/s\n"
+              << "evaluate_hands: " << batched / 1e6 << " M hands/s\n"
+              << "(checksum " << checksum << ")" << std::endl;
+}
@@ -1,4 +1,10 @@
-// compile with g++ -std=c++17 -O2 -Wall gto.cpp -o gto
+// compile with g++ -std=c++17 -O2 -Wall -pthread gto.cpp gto_strategy.cpp strategy_file.cpp evaluator.cpp equity.cpp preflop.cpp alloc_count.cpp telemetry.cpp -o gto
+// (add -DCOUNT_ALLOCATIONS to print the heap allocations of every generation's hands,
+// -DINSTRUMENT instrument.cpp to print the hot-path counters of instrument.hpp every generation)
+// usage: ./gto [--population N] [--threads N] [--seed S] [--resume] [--telemetry FILE]
+// (--resume continues from gto_checkpoint.bin, which is written every 5
+// generations; it needs the --population the checkpoint was saved with;
+// --telemetry writes a JSON line of metrics per generation to FILE)
 // map gamestates to Action probabilites
 // players start with random maps
     // in genetic algo:
@@ -14,25 +20,32 @@
 
 #include <iostream>
 #include <vector>
-#include <set>
-#include <map>
 #include <algorithm>
 #include <random>
 #include <array>
-#include <fstream>
-#include <sstream>
 #include <chrono>
+#include <cmath>
+#include <atomic>
+#include <thread>
+
+#include "alloc_count.hpp"
+#include "instrument.hpp"
+#include "counter_rng.hpp"
+#include "evaluator.hpp"
+#include "equity.hpp"
+#include "preflop.hpp"
+#include "gto_strategy.hpp"
+#include "strategy_file.hpp"
+#include "telemetry.hpp"
 
 using namespace std;
 random_device rd;  // non-deterministic seed
-mt19937 rng(rd()); // Mersenne Twister engine
-uniform_real_distribution<float> get_0to1(0.0f, 1.0f);
-uniform_real_distribution<int> get_0to51(0, 51);
-uniform_real_distribution<float> get_small(-0.05f, 0.05f);
+// per thread, seeded from --seed by main and by every population table
+thread_local CounterRng rng;
+thread_local uniform_real_distribution<float> get_0to1(0.0f, 1.0f);
+thread_local uniform_real_distribution<float> get_small(-0.05f, 0.05f);
 
 
-const int NUM_PLAYERS = 4;
-
 enum Suit { HEARTS, DIAMONDS, CLUBS, SPADES };
 const string SUITS[] = { "H", "D", "C", "S" };
 const string RANKS[] = { "2", "3", "4", "5", "6", "7", "8", "9", "T", "J", "Q", "K", "A" };
@@ -54,230 +67,67 @@ struct Card {
     string toString() const {
         return RANKS[rank] + SUITS[suit];
     }
+
+    static Card from_index(int card) {
+        return { card_rank(card), static_cast<Suit>(card_suit(card)) };
+    }
 };
 
+// draws are uniform without replacement, each one step of a partial
+// Fisher-Yates, so a hand costs one random number per card it deals
 class Deck {
 public:
-    vector<Card> cards;
+    int cards[52];
+    int size;
     Deck() { reset(); }
 
-    void reset() {
-        cards.clear();
+    // puts every card back but the dead ones
+    void reset(CardMask dead = 0) {
+        size = 0;
         for (int r = 0; r < 13; r++) {
             for (int s = 0; s < 4; s++) {
-                cards.push_back({ r, static_cast<Suit>(s) });
+                if (!(dead & card_mask(card_index(r, s)))) cards[size++] = card_index(r, s);
             }
         }
     }
 
-    void shuffle() {
-        
-        std::shuffle(cards.begin(), cards.end(), rng);
-    }
-
-    Card draw() {
-        Card top = cards.back(); cards.pop_back();
-        return top;
-    }
-};
-
-int evaluateBest7CardHand(vector<Card> cards) {
-    array<int, 13> rank_count = {};
-    array<int, 4> suit_count = {};
-    vector<vector<Card>> suit_cards(4);
-
-    for (auto& c : cards) {
-        rank_count[c.rank]++;
-        suit_count[c.suit]++;
-        suit_cards[c.suit].push_back(c);
-    }
-
-    // Sort cards by rank descending
-    sort(cards.begin(), cards.end(), [](const Card& a, const Card& b) {
-        return a.rank > b.rank;
-    });
-
-    // --------- Check for Flush & Straight Flush ---------
-    for (int s = 0; s < 4; ++s) {
-        if (suit_count[s] >= 5) {
-            auto& suited = suit_cards[s];
-            sort(suited.begin(), suited.end(), [](const Card& a, const Card& b) {
-                return a.rank > b.rank;
-            });
-
-            // Check for straight flush
-            vector<int> vals;
-            for (auto& c : suited)
-                vals.push_back(c.rank);
-
-            // Remove duplicates
-            vals.erase(unique(vals.begin(), vals.end()), vals.end());
-
-            for (int i = 0; i <= int(vals.size()) - 5; ++i) {
-                bool isStraight = true;
-                for (int j = 1; j < 5; ++j) {
-                    if (vals[i + j - 1] != vals[i + j] + 1) {
-                        isStraight = false;
-                        break;
-                    }
-                }
-                if (isStraight) {
-                    return 8000000 + vals[i]; // Straight flush
-                }
-            }
-
-            // Check for A-5 straight flush
-            if (find(vals.begin(), vals.end(), 12) != vals.end() &&
-                find(vals.begin(), vals.end(), 3) != vals.end() &&
-                find(vals.begin(), vals.end(), 2) != vals.end() &&
-                find(vals.begin(), vals.end(), 1) != vals.end() &&
-                find(vals.begin(), vals.end(), 0) != vals.end()) {
-                return 8000000 + 3;
-            }
-
-            // Regular flush
-            return 5000000 + suited[0].rank;
-        }
-    }
-
-    // --------- Rank histogram for 4/3/2-of-a-kinds ---------
-    vector<int> ranks;
-    for (int r = 12; r >= 0; --r)
-        for (int i = 0; i < rank_count[r]; ++i)
-            ranks.push_back(r);
-
-    vector<pair<int, int>> count_rank;  // {count, rank}
-    for (int r = 0; r < 13; ++r) {
-        if (rank_count[r] > 0)
-            count_rank.push_back({rank_count[r], r});
-    }
-
-    sort(count_rank.begin(), count_rank.end(), [](auto& a, auto& b) {
-        if (a.first != b.first) return a.first > b.first;
-        return a.second > b.second;
-    });
-
-    int first = count_rank[0].second;
-    int first_count = count_rank[0].first;
-    int second = count_rank.size() > 1 ? count_rank[1].second : -1;
-    int second_count = count_rank.size() > 1 ? count_rank[1].first : 0;
-
-    if (first_count == 4)
-        return 7000000 + (first + 2) * 100 + (second + 2);
-    if (first_count == 3 && second_count >= 2)
-        return 6000000 + (first + 2) * 100 + (second + 2);
-    if (first_count == 3)
-        return 3000000 + (first + 2) * 10000 + ranks[0] * 100 + ranks[1];
-    if (first_count == 2 && second_count == 2)
-        return 2000000 + (first + 2) * 100 + (second + 2) * 10 + ranks[0];
-    if (first_count == 2)
-        return 1000000 + (first + 2) * 10000 + ranks[0] * 100 + ranks[1] * 10 + ranks[2];
-
-    // --------- Check for Straight ---------
-    vector<int> unique_ranks;
-    for (int r = 12; r >= 0; --r)
-        if (rank_count[r]) unique_ranks.push_back(r);
-
-    for (int i = 0; i <= int(unique_ranks.size()) - 5; ++i) {
-        bool straight = true;
-        for (int j = 1; j < 5; ++j) {
-            if (unique_ranks[i + j - 1] != unique_ranks[i + j] + 1) {
-                straight = false;
-                break;
-            }
-        }
-        if (straight) return 4000000 + unique_ranks[i];
-    }
-
-    // A-5 low straight
-    if (rank_count[12] && rank_count[3] && rank_count[2] &&
-        rank_count[1] && rank_count[0])
-        return 4000000 + 3;
-
-    // --------- High Card ---------
-    return (ranks[0] + 2) * 100000 + (ranks[1] + 2) * 10000 + (ranks[2] + 2) * 1000 + (ranks[3] + 2) * 100 + (ranks[4] + 2);
-}
-
-// takes in 7 card hand returns value of best 5 card hand
-int bestHandValue(const vector<Card>& cards) {
-    return evaluateBest7CardHand(cards);
-}
-
-enum Equity {
-    DESTROYED,  // 0-19
-    LOW,        // 20-39
-    NEUTRAL,    // 40-59
-    HIGH,       // 60-79
-    DOMINATION  // 80-100
-};
-
-enum Action {
-    FOLD,
-    CALL, // call = check
-    RAISE_50,
-    RAISE_100,
-    ALL_IN
-};
-
-struct Gamestate {
-    Equity equity_vs_monster;
-    Equity equity_vs_strong;
-    Equity equity_vs_medium;
-    Equity equity_vs_weak;
-    int position; // number of people who act after you reach betting round
-    int post_raises;
-    int pre_raises;
-    bool multiway;
-
-    bool operator< (const Gamestate other) const {
-        if (equity_vs_monster != other.equity_vs_monster) return equity_vs_monster < other.equity_vs_monster;
-        if (equity_vs_strong != other.equity_vs_strong) return equity_vs_strong < other.equity_vs_strong;
-        if (equity_vs_medium != other.equity_vs_medium) return equity_vs_medium < other.equity_vs_medium;
-        if (equity_vs_weak != other.equity_vs_weak) return equity_vs_weak < other.equity_vs_weak;
-        if (position != other.position) return position < other.position;
-        if (post_raises != other.post_raises) return post_raises < other.post_raises;
-        if (pre_raises != other.pre_raises) return pre_raises < other.pre_raises;
-        return multiway < other.multiway;
+    int draw() {
+        deal_to_top(cards, size, 1, rng);
+        return cards[--size];
     }
 };
 
-void normalize_probability(vector<float> &probabilities) {
+// illegal actions get 0
+void normalize_probability(StrategyRow &row) {
     float sum = 0.0000001;
-    for (float &prob: probabilities) {
-        if (prob < 0) prob = 0;
+    for (int a = 0; a < NUM_ACTIONS; ++a) {
+        float &prob = row.probabilities[a];
+        if (prob < 0 || !(row.legal >> a & 1)) prob = 0;
         sum += prob;
     }
-    for (float &prob: probabilities) prob /= sum;
+    for (float &prob: row.probabilities) prob /= sum;
 }
 
 
-vector<float> random_probabilities(Gamestate g) {
-    if (g.pre_raises >= 4 || g.post_raises >= 4) return {(float) 1/2, (float) 1/2};
-    vector<float> probabilities = {get_0to1(rng), get_0to1(rng), get_0to1(rng), get_0to1(rng), get_0to1(rng), get_0to1(rng)};
-    normalize_probability(probabilities);
-    return probabilities;
-}
-
-void mutate_probabilities(vector<float> &probabilities) {
-    for (float & prob: probabilities) {
-        prob += get_small(rng);
-    }
-    normalize_probability(probabilities);
+StrategyRow random_probabilities(Gamestate g) {
+    StrategyRow row;
+    row.legal = legal_actions(g);
+    for (float &prob: row.probabilities) prob = get_0to1(rng);
+    normalize_probability(row);
+    return row;
 }
 
-map<Gamestate, vector<float>> get_modified_strategy(map<Gamestate, vector<float>> &strategy) {
-    map<Gamestate, vector<float>> new_strategy;
-    for (auto [gamestate, probabilities]: strategy) {
-        mutate_probabilities(probabilities);
-        new_strategy[gamestate] = probabilities;
+void mutate_probabilities(StrategyRow &row) {
+    for (int a = 0; a < NUM_ACTIONS; ++a) {
+        if (row.legal >> a & 1) row.probabilities[a] += get_small(rng);
     }
-    return new_strategy;
+    normalize_probability(row);
 }
 
 class Player {
     public:
-        vector<Card> hole_cards;
-        map<Gamestate, vector<float>> strategy;
+        CardMask hole_cards;
+        OverlayStrategy strategy;
         int stack_size;
         int position;
         int bet_made;
@@ -285,195 +135,125 @@ class Player {
         Gamestate gamestate;
 
         int total_profit;
-        bool mutate;
+        bool mutate; // every row played is mutated again
+        int member; // population index in population mode
 
         Action decideAction () {
-            if (strategy.find(gamestate) == strategy.end()) strategy[gamestate] = random_probabilities(gamestate);
-            if (mutate) mutate_probabilities(strategy[gamestate]);
+            int index = gamestate_index(gamestate);
+            StrategyRow *own = strategy.find(index);
+            const StrategyRow &shared = strategy.base_row(index);
+            count_event(STRATEGY_LOOKUPS);
+            if (!own && !shared.legal) count_event(STRATEGY_MISSES);
+            // the row leaves the shared base the first time it has to change
+            if (!own && (!shared.legal || mutate || strategy.mutant)) {
+                own = &strategy.insert(index, shared.legal ? shared : random_probabilities(gamestate));
+                if (shared.legal && strategy.mutant) mutate_probabilities(*own);
+            }
+            if (own && mutate) mutate_probabilities(*own);
+            const StrategyRow &row = own ? *own : shared;
 
             float rand_num = get_0to1(rng);
             float cumulative = 0;
-            for (int i = 0; i < strategy[gamestate].size(); ++i) {
-                float probability = strategy[gamestate][i];
-                Action action = static_cast<Action>(i);
-                cumulative += probability;
+            Action action = FOLD;
+            for (int i = 0; i < NUM_ACTIONS; ++i) {
+                if (!(row.legal >> i & 1)) continue;
+                action = static_cast<Action>(i);
+                cumulative += row.probabilities[i];
                 if (rand_num < cumulative) {
                     return action;
                 }
             }
-            return ALL_IN;
+            return action;
         }
 };
 
 
-vector<pair<Card, Card>> MONSTERS;
-vector<pair<Card, Card>> STRONG;
-vector<pair<Card, Card>> MEDIUM;
-vector<pair<Card, Card>> WEAK;
+// villain ranges, indexed by HandBucket
+vector<WeightedHand> BUCKETS[NUM_BUCKETS];
+
+// hero-vs-bucket preflop equities, loaded from PREFLOP_EQUITY_FILE
+PreflopEquities PREFLOP_EQUITY;
+bool have_preflop_equity = false;
 
 void bucket_hands() {
     Deck deck;
-    for (int i = 0; i < deck.cards.size()-1; ++i) {
-        Card c1 = deck.cards[i];
-        for (int j = i+1; j < deck.cards.size(); ++j) {
-            Card c2 = deck.cards[j];
-            if (c1.rank == c2.rank && c1.rank >= 9) {
-                MONSTERS.push_back({c2, c1});
-            }
-            else if (c1.rank >= 10 && c2.rank >= 12) {
-                MONSTERS.push_back({c2, c1});
-            }
-            else if (c1.rank >= 8 && c2.rank >= 8) {
-                STRONG.push_back({c2, c1});
-            }
-            else if (c1.rank == c2.rank && c1.rank >= 5) {
-                STRONG.push_back({c2, c1});
-            }
-            else if (c2.rank == 12 && c1.suit == c2.suit) {
-                STRONG.push_back({c2, c1});
-            }
-            else if (c2.rank - c1.rank == 1 && c1.suit == c2.suit && c1.rank >= 3) {
-                STRONG.push_back({c2, c1});
-            }
-            else if (c2.rank - c1.rank <= 1 || c1.suit == c2.suit ) {
-                MEDIUM.push_back({c2, c1});
-            }
-            else {
-                WEAK.push_back({c2, c1});
-            }
-
+    for (int i = 0; i < deck.size-1; ++i) {
+        for (int j = i+1; j < deck.size; ++j) {
+            WeightedHand hand = {card_mask(deck.cards[i]) | card_mask(deck.cards[j]), 1.0f};
+            BUCKETS[hand_bucket(hand.cards)].push_back(hand);
         }    
     }
 }
 
+Equity to_equity_bucket(float equity) {
+    return static_cast<Equity> (min(int (equity / 0.2), int (DOMINATION)));
+}
 
-
-tuple<Equity, Equity, Equity, Equity> get_equities(vector<Card> &hole_cards, vector<Card> &community_cards) {
-    auto calculate_equity = [&](vector<Card> &hero, vector<Card> &villain, vector<Card> &community_cards, set<Card> &cards_in_play) {
-        int score = 0;
-        int total = 20;
-        for (int i = 0; i < 10; ++i) {
-            vector<Card> community = community_cards;
-            while (community.size() < 5) {
-                int rand_card = get_0to51(rng);
-                Card draw = {(rand_card / 4), static_cast<Suit>(rand_card % 4)};
-                if (cards_in_play.count(draw)) {
-                    continue;
-                }
-                community.push_back(draw);
-            }
-            vector<Card> v = villain;
-            v.insert(v.end(), community.begin(), community.end());
-            int v_score = bestHandValue(v);
-
-            vector<Card> h = hero;
-            h.insert(h.end(), community.begin(), community.end());
-            int h_score = bestHandValue(h);
-            if (h_score > v_score) {
-                score += 2;
-            }
-            else if (h_score == v_score) {
-                score += 1;
+// equity buckets of n hands against every villain bucket; postflop all hands
+// share one set of runouts
+void get_equities(const CardMask *hole_cards, int n, CardMask community_cards, Equity (*equities)[NUM_BUCKETS]) {
+    ScopedTimer timer(EQUITY_TIME);
+    if (community_cards == 0 && have_preflop_equity) {
+        for (int h = 0; h < n; ++h) {
+            for (int b = 0; b < NUM_BUCKETS; ++b) {
+                equities[h][b] = to_equity_bucket(PREFLOP_EQUITY[starting_hand(hole_cards[h])][b]);
             }
         }
-        return (float) score / total;
-    };
-    set<Card> set = {community_cards.begin(), community_cards.end()};
-    set.insert(hole_cards[0]);
-    set.insert(hole_cards[1]);
-    float equity = 0;
-    shuffle(MONSTERS.begin(), MONSTERS.end(), rng);
-    shuffle(STRONG.begin(), STRONG.end(), rng);
-    shuffle(MEDIUM.begin(), MEDIUM.end(), rng);
-    shuffle(WEAK.begin(), WEAK.end(), rng);
-    int samples = 0;
-    for (int i = 0; i <= 25; ++i) {
-        auto& [c1, c2] = MONSTERS[i];
-        if (set.count(c1) || set.count(c2)) continue;
-        samples++;
-        vector<Card> villain = {c1, c2};
-        equity += calculate_equity(hole_cards, villain, community_cards, set);
-    }
-    equity /= samples;
-    Equity monster = static_cast<Equity> (int (equity / 0.2));
-
-    equity = 0;
-    samples = 0;
-    for (int i = 0; i <= 25; ++i) {
-        auto& [c1, c2] = STRONG[i];
-        if (set.count(c1) || set.count(c2)) continue;
-        samples++;
-        vector<Card> villain = {c1, c2};
-        equity += calculate_equity(hole_cards, villain, community_cards, set);
-    }
-    equity /= samples;
-    Equity strong = static_cast<Equity> (int (equity / 0.2));
-
-    equity = 0;
-    samples = 0;
-    for (int i = 0; i <= 25; ++i) {
-        auto& [c1, c2] = MEDIUM[i];
-        if (set.count(c1) || set.count(c2)) continue;
-        samples++;
-        vector<Card> villain = {c1, c2};
-        equity += calculate_equity(hole_cards, villain, community_cards, set);
+        return;
     }
-    equity /= samples;
-    Equity medium = static_cast<Equity> (int (equity / 0.2));
-
-    equity = 0;
-    samples = 0;
-    for (int i = 0; i <= 25; ++i) {
-        auto& [c1, c2] = WEAK[i];
-        if (set.count(c1) || set.count(c2)) continue;
-        samples++;
-        vector<Card> villain = {c1, c2};
-        equity += calculate_equity(hole_cards, villain, community_cards, set);
+    EquityResult results[NUM_PLAYERS * NUM_BUCKETS];
+    calculate_equities(hole_cards, n, community_cards, BUCKETS, NUM_BUCKETS, rng(), results);
+    for (int h = 0; h < n; ++h) {
+        for (int b = 0; b < NUM_BUCKETS; ++b) {
+            equities[h][b] = to_equity_bucket(results[h * NUM_BUCKETS + b].equity);
+            count_event(EQUITY_PAIRS, results[h * NUM_BUCKETS + b].samples);
+        }
     }
-    equity /= samples;
-    Equity weak = static_cast<Equity> (int (equity / 0.2));
-
-    return {monster, strong, medium, weak};
 }
 
-Gamestate get_gamestate(vector<Player> &players, int player, vector<Card> &community_cards, int pre_raises, int post_raises) {
+Gamestate get_gamestate(vector<Player> &players, int player, const Equity *equities, int pre_raises, int post_raises) {
     Gamestate g;
     int position = 0;
     int in_pot = 0;
-    for (int i = 0; i < players.size(); ++i) {
+    for (int i = 0; i < NUM_PLAYERS; ++i) {
         if (i > player && !players[i].folded) position++;
         if (!players[i].folded) in_pot++;
     }
     bool multiway = in_pot > 2;
-    auto [monster, strong, medium, weak] =  get_equities(players[player].hole_cards, community_cards);
-
-    g.equity_vs_monster = monster;
-    g.equity_vs_strong = strong;
-    g.equity_vs_medium = medium;
-    g.equity_vs_weak = weak;
+    g.equity_vs_monster = equities[MONSTER_HANDS];
+    g.equity_vs_strong = equities[STRONG_HANDS];
+    g.equity_vs_medium = equities[MEDIUM_HANDS];
+    g.equity_vs_weak = equities[WEAK_HANDS];
 
     g.multiway = multiway;
     g.position = position;
-    g.post_raises = post_raises;
-    g.pre_raises = pre_raises;
+    g.post_raises = min(post_raises, MAX_RAISES);
+    g.pre_raises = min(pre_raises, MAX_RAISES);
 
     return g;
 }
 
-void bettingRound(vector<Player>& players, vector<Card> community_cards, int& pre_r, int& post_r, int& pot, int& currentBet, int startingIndex = 0) {
+void bettingRound(vector<Player>& players, CardMask community_cards, int& pre_r, int& post_r, int& pot, int& currentBet, int startingIndex = 0) {
     const int numPlayers = players.size();
     int current = startingIndex;
     int lastAggressor = -1;
 
     // Count active players & assign gamestates
     int active = 0;
+    int seats[NUM_PLAYERS];
+    CardMask hole_cards[NUM_PLAYERS];
     for (int i = 0; i < numPlayers; ++i) {
         if (!players[i].folded && players[i].stack_size > 0) {
-            active++;
-            players[i].gamestate = get_gamestate(players, i, community_cards, pre_r, post_r);
+            seats[active] = i;
+            hole_cards[active++] = players[i].hole_cards;
         }
     }
     if (active <= 1) return;
+    Equity equities[NUM_PLAYERS][NUM_BUCKETS];
+    get_equities(hole_cards, active, community_cards, equities);
+    for (int k = 0; k < active; ++k) {
+        players[seats[k]].gamestate = get_gamestate(players, seats[k], equities[k], pre_r, post_r);
+    }
 
     bool bettingComplete = false;
     int consecutiveCalls = 0;
@@ -507,7 +287,7 @@ void bettingRound(vector<Player>& players, vector<Card> community_cards, int& pr
                 lastAggressor = current;
                 consecutiveCalls = 1;
 
-                if (community_cards.size() == 0) pre_r = 4;
+                if (community_cards == 0) pre_r = 4;
                 else post_r = 4;
             }
             else { // raise
@@ -524,7 +304,7 @@ void bettingRound(vector<Player>& players, vector<Card> community_cards, int& pr
                 lastAggressor = current;
                 consecutiveCalls = 1;
 
-                if (community_cards.size() == 0) pre_r++;
+                if (community_cards == 0) pre_r++;
                 else post_r++;
             }
         } else {
@@ -539,27 +319,30 @@ void bettingRound(vector<Player>& players, vector<Card> community_cards, int& pr
     }
 }
 
-void showdown(vector<Player> &players, vector<Card> &community, int &pot, Deck &deck) {
-    vector<int> winners;
+void showdown(vector<Player> &players, CardMask &community, int &pot, Deck &deck) {
+    count_event(SHOWDOWNS);
+    int winners[NUM_PLAYERS];
+    int num_winners = 0;
     int best_score = -1;
-    for (int i = 0; i < players.size(); ++i) {
+    CardMask hands[NUM_PLAYERS];
+    int scores[NUM_PLAYERS];
+    for (int i = 0; i < NUM_PLAYERS; ++i) hands[i] = players[i].hole_cards;
+    evaluate_hands(hands, community, scores, NUM_PLAYERS);
+    for (int i = 0; i < NUM_PLAYERS; ++i) {
         if (players[i].folded) continue;
-        community.push_back(players[i].hole_cards[0]);
-        community.push_back(players[i].hole_cards[1]);
-        int score = bestHandValue(community);
+        int score = scores[i];
         if (score > best_score) {
-            winners.clear();
-            winners.push_back(i);
+            num_winners = 0;
+            winners[num_winners++] = i;
             best_score = score;
         }
         else if (score == best_score) {
-            winners.push_back(i);
+            winners[num_winners++] = i;
         }
-        community.pop_back(); community.pop_back();
     }
     
-    for (int winner: winners) {
-        players[winner].stack_size += pot/winners.size();
+    for (int w = 0; w < num_winners; ++w) {
+        players[winners[w]].stack_size += pot / num_winners;
     }
 
     for (auto &p: players) {
@@ -567,91 +350,23 @@ void showdown(vector<Player> &players, vector<Card> &community, int &pot, Deck &
         p.stack_size = 100;
         p.bet_made = 0;
         p.folded = false;
-        deck.cards.push_back(p.hole_cards.back()); p.hole_cards.pop_back();
-        deck.cards.push_back(p.hole_cards.back()); p.hole_cards.pop_back();
+        p.hole_cards = 0;
     }
-    deck.cards.push_back(community.back()); community.pop_back();
-    deck.cards.push_back(community.back()); community.pop_back();
-    deck.cards.push_back(community.back()); community.pop_back();
-    deck.cards.push_back(community.back()); community.pop_back();
-    deck.cards.push_back(community.back()); community.pop_back();
+    community = 0;
+    deck.reset();
 
     pot = 0;
 }
 
-void save_strategy_to_file(const map<Gamestate, vector<float>>& strategy, const string& filename) {
-    ofstream file(filename);
-    if (!file.is_open()) {
-        cerr << "Failed to open file for writing: " << filename << endl;
-        return;
-    }
-
-    for (const auto& [g, probs] : strategy) {
-        file << g.equity_vs_monster << " "
-             << g.equity_vs_strong << " "
-             << g.equity_vs_medium << " "
-             << g.equity_vs_weak << " "
-             << g.position << " "
-             << g.post_raises << " "
-             << g.pre_raises << " "
-             << g.multiway << " ";
-
-        for (float p : probs) file << p << " ";
-        file << '\n';
-    }
-
-    file.close();
-}
-
-map<Gamestate, vector<float>> load_strategy_from_file(const string& filename) {
-    map<Gamestate, vector<float>> strategy;
-    ifstream file(filename);
-    if (!file.is_open()) {
-        cerr << "Failed to open file: " << filename << endl;
-        return strategy;
-    }
-
-    string line;
-    while (getline(file, line)) {
-        istringstream iss(line);
-        int eq_monster, eq_strong, eq_medium, eq_weak;
-        int position, post_raises, pre_raises, multiway_int;
-
-        iss >> eq_monster >> eq_strong >> eq_medium >> eq_weak
-            >> position >> post_raises >> pre_raises >> multiway_int;
-
-        vector<float> probs;
-        float prob;
-        while (iss >> prob) {
-            probs.push_back(prob);
-        }
-
-        Gamestate g = {
-            static_cast<Equity>(eq_monster),
-            static_cast<Equity>(eq_strong),
-            static_cast<Equity>(eq_medium),
-            static_cast<Equity>(eq_weak),
-            position,
-            post_raises,
-            pre_raises,
-            static_cast<bool>(multiway_int)
-        };
-
-        strategy[g] = probs;
-    }
-
-    return strategy;
-}
-
-map<Gamestate, vector<float>> initial_strategy() {
-    map<Gamestate, vector<float>> strat;
+Strategy initial_strategy() {
+    Strategy strat(NUM_GAMESTATES, StrategyRow());
     for (int a = DESTROYED; a <= DOMINATION; ++a) {
         for (int b = DESTROYED; b <= DOMINATION; ++b) {
             for (int c = DESTROYED; c <= DOMINATION; ++c) {
                 for (int d = DESTROYED; d <= DOMINATION; ++d) {
                     for (int pos = 0; pos < NUM_PLAYERS; ++pos) {
-                        for (int post_r = 0; post_r < 5; ++post_r) {
-                            for (int pre_r = 0; pre_r < 5; ++pre_r) {
+                        for (int post_r = 0; post_r <= MAX_RAISES; ++post_r) {
+                            for (int pre_r = 0; pre_r <= MAX_RAISES; ++pre_r) {
                                 for (bool multiway: {false, true}) {
                                     Gamestate g = {
                                         static_cast<Equity>(a),
@@ -673,7 +388,12 @@ map<Gamestate, vector<float>> initial_strategy() {
                                     else if (a + b + c <= 10) p = {0, 0.30, 0.30, 0.40};
                                     else p = {0, 0.2, 0.2, 0.6};
 
-                                    strat[g] = p;
+                                    StrategyRow &row = strat[gamestate_index(g)];
+                                    row = {};
+                                    for (int i = 0; i < (int) p.size(); ++i) {
+                                        row.probabilities[i] = p[i];
+                                        row.legal |= 1 << i;
+                                    }
 
                                 }
                             }
@@ -687,61 +407,283 @@ map<Gamestate, vector<float>> initial_strategy() {
     return strat;
 }
 
-int main() {
-    string filename = "strategy.txt";
-    map<Gamestate, vector<float>> strat = load_strategy_from_file(filename);
+// one hand at the table, then a fresh deal and a new seating order
+// made by play_round on every thread, see alloc_count.hpp
+atomic<uint64_t> hand_allocations(0);
+
+void play_round(vector<Player> &players, Deck &deck) {
+    ScopedTimer timer(HAND_TIME);
+    uint64_t allocations = thread_allocations();
+    CardMask community = 0;
+    // blinds
+    players[0].bet_made = 1;
+    players[0].stack_size -= 1;
+    players[1].bet_made = 2;
+    players[1].stack_size -= 2;
+    int current_bet = 2;
+    int pot = 3;
+    int pre_raises = 0;
+    int post_raises = 0;
+
+    bettingRound(players, community, pre_raises, post_raises, pot, current_bet, 2);
+
+    community |= card_mask(deck.draw());
+    community |= card_mask(deck.draw());
+    community |= card_mask(deck.draw());
+
+    bettingRound(players, community, pre_raises, post_raises, pot, current_bet, 0);
+    community |= card_mask(deck.draw());
+    bettingRound(players, community, pre_raises, post_raises, pot,  current_bet, 0);
+    community |= card_mask(deck.draw());
+    bettingRound(players, community, pre_raises, post_raises, pot,  current_bet, 0);
+
+    showdown(players, community, pot, deck);
+
+    for (int i = 0; i < NUM_PLAYERS; ++i) {
+        players[i].hole_cards = card_mask(deck.draw()) | card_mask(deck.draw());
+    }
+    shuffle(players.begin(), players.end(), rng);
+    hand_allocations += thread_allocations() - allocations;
+}
+
+const int GENERATIONS = 100;
+const int ROUNDS_PER_GENERATION = 50;
+
+// population mode: every seating plays this many hands at each table
+const int HANDS_PER_TABLE = 50;
+const int SEATINGS_PER_GENERATION = 4;
+
+const int CHECKPOINT_INTERVAL = 5; // generations
+
+// with -DCOUNT_ALLOCATIONS, what the generation's hands allocated; should be 0
+void report_allocations(int gen) {
+    if (!ALLOCATION_COUNTING) return;
+    cout << gen << " heap allocations in hands " << hand_allocations.exchange(0) << '\n';
+}
+
+// with -DINSTRUMENT, the generation's hot-path counters
+void report_counters(int gen) {
+    if (!INSTRUMENTING) return;
+    cout << gen << " counters " << counter_report() << '\n';
+}
+
+// with --telemetry
+Telemetry telemetry;
+Strategy last_winner; // the previous generation's winning table
+
+/* The generation's hands per second, the winner's profit, the rows its
+   overlay holds and the L1 distance from its table to the previous winner's. */
+void record_generation(int gen, int hands, chrono::steady_clock::time_point start, long best_profit,
+                       const OverlayStrategy &winner) {
+    if (!telemetry.is_open()) return;
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    Strategy table = winner.flatten();
+    double change = 0;
+    for (size_t i = 0; i < last_winner.size(); ++i) {
+        for (int a = 0; a < NUM_ACTIONS; ++a) change += fabs(table[i].probabilities[a] - last_winner[i].probabilities[a]);
+    }
+    last_winner = move(table);
+    telemetry.record({
+        {"generation", double(gen)},
+        {"hands_per_s", hands / elapsed.count()},
+        {"best_profit", double(best_profit)},
+        {"overlay_rows", double(winner.overlay_rows())},
+        {"strategy_change", change},
+    });
+}
+
+// reseeds rng from a seed drawn from it; a checkpoint saves the seed, so the
+// run that saved it and a run resumed from it draw the same numbers after it
+uint64_t restart_rng() {
+    uint64_t seed = rng();
+    rng.seed(seed);
+    return seed;
+}
+
+// a full deck and new hole cards, as at the start of a run
+void deal_new_hands(vector<Player> &players, Deck &deck) {
+    deck.reset();
+    for (Player &p: players) p.hole_cards = card_mask(deck.draw()) | card_mask(deck.draw());
+}
+
+struct Member {
+    OverlayStrategy strategy;
+    long total_profit;
+};
+
+/* Seats the members at NUM_PLAYERS-handed tables and plays them on num_threads
+   threads. Each member sits at exactly one table, so the tables never share a
+   strategy. Table t draws from stream t of seed and nothing else, which makes
+   the result independent of how the tables land on threads. */
+void play_seating(vector<Member> &population, const vector<int> &seating, int num_threads, uint64_t seed) {
+    int num_tables = seating.size() / NUM_PLAYERS;
+    atomic<int> next_table(0);
+    auto worker = [&]() {
+        for (int t = next_table++; t < num_tables; t = next_table++) {
+            rng.seed(seed, t);
+
+            Deck deck;
+            vector<Player> players(NUM_PLAYERS);
+            for (int i = 0; i < NUM_PLAYERS; ++i) {
+                Member &m = population[seating[t * NUM_PLAYERS + i]];
+                players[i].stack_size = 100;
+                players[i].position = NUM_PLAYERS - 1 - i;
+                players[i].hole_cards = card_mask(deck.draw()) | card_mask(deck.draw());
+                players[i].strategy = move(m.strategy);
+                players[i].member = seating[t * NUM_PLAYERS + i];
+            }
+            for (int hand = 0; hand < HANDS_PER_TABLE; ++hand) play_round(players, deck);
+            for (Player &p: players) {
+                Member &m = population[p.member];
+                m.strategy = move(p.strategy);
+                m.total_profit += p.total_profit;
+            }
+        }
+    };
+    vector<thread> threads;
+    for (int i = 0; i < num_threads; ++i) threads.emplace_back(worker);
+    for (thread &th: threads) th.join();
+}
+
+void run_population(vector<Member> &population, int first_gen, int num_threads, const string &filename) {
+    int size = population.size();
+    vector<int> seating(size);
+    for (int i = 0; i < size; ++i) seating[i] = i;
+    int survivors = max(1, size / NUM_PLAYERS);
+
+    for (int gen = first_gen; gen < GENERATIONS; ++gen) {
+        auto start = chrono::steady_clock::now();
+        for (int s = 0; s < SEATINGS_PER_GENERATION; ++s) {
+            shuffle(seating.begin(), seating.end(), rng);
+            play_seating(population, seating, num_threads, rng());
+        }
+        // fittest first, ties broken by member order
+        stable_sort(population.begin(), population.end(), [](const Member &a, const Member &b) {
+            return a.total_profit > b.total_profit;
+        });
+        cout << gen << " best profit " << population[0].total_profit << '\n';
+        report_allocations(gen);
+        report_counters(gen);
+        record_generation(gen, SEATINGS_PER_GENERATION * size / NUM_PLAYERS * HANDS_PER_TABLE, start,
+                          population[0].total_profit, population[0].strategy);
+        if (gen % 5 == 4) save_strategy_binary(population[0].strategy.flatten(), filename);
+
+        /* The top quarter carries over, everyone else becomes a mutant of a
+           survivor: the survivor's table, mutated row by row as it is played.
+           Survivors first fold their overlays into their bases, in place once
+           the old mutants have let go of them. */
+        for (int i = survivors; i < size; ++i) population[i].strategy.clear();
+        for (int i = 0; i < survivors; ++i) population[i].strategy.merge();
+        for (int i = survivors; i < size; ++i) population[i].strategy.become_mutant_of(population[i % survivors].strategy);
+        for (Member &m: population) m.total_profit = 0;
+
+        if (gen % CHECKPOINT_INTERVAL == CHECKPOINT_INTERVAL - 1) {
+            GtoCheckpoint meta = {gen + 1, size, restart_rng()};
+            // overlays are empty here, so the bases are the whole state
+            vector<const StrategyRow *> strategies;
+            vector<uint8_t> mutate;
+            for (const Member &m: population) {
+                strategies.push_back(m.strategy.base_table());
+                mutate.push_back(m.strategy.mutant);
+            }
+            // seatings are shuffled in place, so restart them as a resumed run does
+            for (int i = 0; i < size; ++i) seating[i] = i;
+            save_checkpoint(CHECKPOINT_FILE, meta, mutate, strategies);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int population = 0;
+    int num_threads = 1;
+    uint64_t seed = rd();
+    bool resume = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--population" && i + 1 < argc) population = stoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc) num_threads = stoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = stoull(argv[++i]);
+        else if (arg == "--resume") resume = true;
+        else if (arg == "--telemetry" && i + 1 < argc) {
+            if (!telemetry.open(argv[++i])) return 1;
+        }
+        else {
+            cerr << "usage: " << argv[0] << " [--population N] [--threads N] [--seed S] [--resume] [--telemetry FILE]" << endl;
+            return 2;
+        }
+    }
+    if (population && (population < NUM_PLAYERS || population % NUM_PLAYERS)) {
+        cerr << "--population must be a positive multiple of " << NUM_PLAYERS << endl;
+        return 2;
+    }
+    if (num_threads < 1) num_threads = max(1u, thread::hardware_concurrency());
+    rng.seed(seed);
+
+    // strategy.bin once a run has saved one, read in place from its mapping;
+    // strategy_convert turns it back into text
+    string filename = STRATEGY_BINARY_FILE;
+    StrategyRows mapped = is_strategy_file(filename) ? load_strategy_binary(filename) : nullptr;
+    OverlayStrategy start = mapped ? OverlayStrategy(move(mapped))
+                                   : OverlayStrategy(make_shared<Strategy>(load_strategy_from_file(STRATEGY_TEXT_FILE)));
     bucket_hands();
+    have_preflop_equity = load_preflop_equities(PREFLOP_EQUITY_FILE, PREFLOP_EQUITY);
+
+    // a checkpoint replaces the strategies and the rng state --seed gave
+    int first_gen = 0;
+    GtoCheckpoint meta;
+    vector<uint8_t> saved_mutate;
+    vector<StrategyRows> saved;
+    if (resume) {
+        if (!load_checkpoint(CHECKPOINT_FILE, meta, saved_mutate, saved)) return 1;
+        if (meta.population != population) {
+            cerr << CHECKPOINT_FILE << " was saved with --population " << meta.population << endl;
+            return 1;
+        }
+        first_gen = meta.generation;
+        rng.seed(meta.seed);
+    }
+
+    // everyone starts out sharing one table, or the one they were saved with
+    auto starting_strategy = [&](int i) {
+        if (!resume) return start;
+        return OverlayStrategy(move(saved[i]));
+    };
+
+    if (population) {
+        vector<Member> members;
+        for (int i = 0; i < population; ++i) {
+            members.push_back(Member{starting_strategy(i), 0});
+            members[i].strategy.mutant = resume && saved_mutate[i];
+        }
+        start.clear(); // only the members hold the starting table now
+        run_population(members, first_gen, num_threads, filename);
+        return 0;
+    }
+
     Deck deck;
-    deck.shuffle();
-    vector<Card> community;
     vector<Player> players(NUM_PLAYERS);
     for (int i = 0; i < NUM_PLAYERS; ++i) {
         players[i].stack_size = 100;
         players[i].position = NUM_PLAYERS - 1 - i;
-        players[i].hole_cards.push_back(deck.draw());
-        players[i].hole_cards.push_back(deck.draw());
-        players[i].strategy = strat;
+        players[i].strategy = starting_strategy(i);
+        players[i].mutate = resume && saved_mutate[i];
     }
+    start.clear();
+    deal_new_hands(players, deck);
     // players[0].strategy = initial_strategy();
     
     
-    for (int gen = 0; gen < 100; ++gen) {
-        for (int round = 0; round < 50; ++round) {
-            // blinds
-            players[0].bet_made = 1;
-            players[0].stack_size -= 1;
-            players[1].bet_made = 2;
-            players[1].stack_size -= 2;
-            int current_bet = 2;
-            int pot = 3;
-            int pre_raises = 0;
-            int post_raises = 0;
-
-            bettingRound(players, community, pre_raises, post_raises, pot, current_bet, 2);
-
-            community.push_back(deck.draw());
-            community.push_back(deck.draw());
-            community.push_back(deck.draw());
-
-            bettingRound(players, community, pre_raises, post_raises, pot, current_bet, 0);
-            community.push_back(deck.draw());
-            bettingRound(players, community, pre_raises, post_raises, pot,  current_bet, 0);
-            community.push_back(deck.draw());
-            bettingRound(players, community, pre_raises, post_raises, pot,  current_bet, 0);
-
-            showdown(players, community, pot, deck);
-            deck.shuffle();
-            
-            for (int i = 0; i < NUM_PLAYERS; ++i) {
-                players[i].hole_cards.push_back(deck.draw());
-                players[i].hole_cards.push_back(deck.draw());
-            }
-            shuffle(players.begin(), players.end(), rng);
-
+    for (int gen = first_gen; gen < GENERATIONS; ++gen) {
+        auto start = chrono::steady_clock::now();
+        for (int round = 0; round < ROUNDS_PER_GENERATION; ++round) {
+            play_round(players, deck);
         }
-        sort(players.begin(), players.end(), [](const Player a, const Player b){ return a.total_profit > b.total_profit;});
-        if (gen % 5 == 4) save_strategy_to_file(players[0].strategy, filename);
+        sort(players.begin(), players.end(), [](const Player &a, const Player &b){ return a.total_profit > b.total_profit;});
+        if (gen % 5 == 4) save_strategy_binary(players[0].strategy.flatten(), filename);
         cout << gen << '\n';
+        report_allocations(gen);
+        report_counters(gen);
+        record_generation(gen, ROUNDS_PER_GENERATION, start, players[0].total_profit, players[0].strategy);
 
         players[3].mutate = true;
         players[2].mutate = true;
@@ -752,5 +694,18 @@ int main() {
         }
         shuffle(players.begin(), players.end(), rng);
 
+        if (gen % CHECKPOINT_INTERVAL == CHECKPOINT_INTERVAL - 1) {
+            GtoCheckpoint checkpoint = {gen + 1, 0, restart_rng()};
+            vector<Strategy> tables;
+            vector<const StrategyRow *> strategies;
+            vector<uint8_t> mutate;
+            for (const Player &p: players) {
+                tables.push_back(p.strategy.flatten());
+                mutate.push_back(p.mutate);
+            }
+            for (const Strategy &table: tables) strategies.push_back(table.data());
+            deal_new_hands(players, deck);
+            save_checkpoint(CHECKPOINT_FILE, checkpoint, mutate, strategies);
+        }
     }
 }
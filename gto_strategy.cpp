@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "gto_strategy.hpp"
+#include "strategy_file.hpp"
+
+namespace {
+
+std::vector<StrategySection> gto_sections(const StrategyRow *strategy) {
+    return {{strategy, uint32_t(NUM_GAMESTATES), uint32_t(sizeof(StrategyRow))}};
+}
+
+// a section of file, which stays mapped while any of them lives
+StrategyRows mapped_rows(const std::shared_ptr<const MappedStrategyFile> &file, int section) {
+    return StrategyRows(file, static_cast<const StrategyRow *>(file->section(section)));
+}
+
+std::vector<StrategySection> checkpoint_sections(const GtoCheckpoint *meta, const uint8_t *mutate,
+                                                const std::vector<const StrategyRow *> &strategies) {
+    std::vector<StrategySection> sections = {
+        {meta, 1, uint32_t(sizeof(GtoCheckpoint))},
+        {mutate, uint32_t(strategies.size()), uint32_t(sizeof(uint8_t))},
+    };
+    for (const StrategyRow *strategy: strategies) {
+        sections.push_back(gto_sections(strategy)[0]);
+    }
+    return sections;
+}
+
+constexpr int MIN_OVERLAY_SLOTS = 1024;
+
+} // namespace
+
+int OverlayStrategy::slot(int index) const {
+    int mask = keys.size() - 1;
+    int s = (uint32_t(index) * 2654435761u) & mask;
+    while (keys[s] != -1 && keys[s] != index) s = (s + 1) & mask;
+    return s;
+}
+
+StrategyRow *OverlayStrategy::find(int index) {
+    if (!used) return nullptr;
+    int s = slot(index);
+    return keys[s] == index ? &rows[s] : nullptr;
+}
+
+StrategyRow &OverlayStrategy::insert(int index, const StrategyRow &row) {
+    // kept at most half full
+    if (2 * (used + 1) > int(keys.size())) {
+        std::vector<int32_t> old_keys(std::max<size_t>(MIN_OVERLAY_SLOTS, 2 * keys.size()), -1);
+        std::vector<StrategyRow> old_rows(old_keys.size());
+        old_keys.swap(keys);
+        old_rows.swap(rows);
+        for (size_t s = 0; s < old_keys.size(); ++s) {
+            if (old_keys[s] == -1) continue;
+            int t = slot(old_keys[s]);
+            keys[t] = old_keys[s];
+            rows[t] = old_rows[s];
+        }
+    }
+    int s = slot(index);
+    if (keys[s] == -1) {
+        keys[s] = index;
+        used++;
+    }
+    rows[s] = row;
+    return rows[s];
+}
+
+Strategy OverlayStrategy::flatten() const {
+    Strategy strategy(base.get(), base.get() + NUM_GAMESTATES);
+    for (size_t s = 0; used && s < keys.size(); ++s) {
+        if (keys[s] != -1) strategy[keys[s]] = rows[s];
+    }
+    return strategy;
+}
+
+void OverlayStrategy::merge() {
+    mutant = false;
+    if (!used) return;
+    if (writable && base.use_count() == 1) {
+        // nobody else sees this base, so it can change in place
+        for (size_t s = 0; s < keys.size(); ++s) {
+            if (keys[s] != -1) writable[keys[s]] = rows[s];
+        }
+    }
+    else {
+        auto table = std::make_shared<Strategy>(flatten());
+        writable = table->data();
+        base = StrategyRows(std::move(table), writable);
+    }
+    clear_overlay();
+}
+
+void OverlayStrategy::become_mutant_of(const OverlayStrategy &parent) {
+    base = parent.base;
+    writable = parent.writable;
+    clear_overlay();
+    mutant = true;
+}
+
+void OverlayStrategy::clear() {
+    base.reset();
+    writable = nullptr;
+    clear_overlay();
+    mutant = false;
+}
+
+void OverlayStrategy::clear_overlay() {
+    if (!used) return;
+    std::fill(keys.begin(), keys.end(), -1);
+    used = 0;
+}
+
+// rows are written up to their highest legal action
+void save_strategy_to_file(const StrategyRow *strategy, const std::string &filename) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for writing: " << filename << std::endl;
+        return;
+    }
+
+    for (int index = 0; index < NUM_GAMESTATES; ++index) {
+        const StrategyRow &row = strategy[index];
+        if (!row.legal) continue;
+        Gamestate g = gamestate_from_index(index);
+        file << g.equity_vs_monster << " "
+             << g.equity_vs_strong << " "
+             << g.equity_vs_medium << " "
+             << g.equity_vs_weak << " "
+             << g.position << " "
+             << g.post_raises << " "
+             << g.pre_raises << " "
+             << g.multiway << " ";
+
+        for (int a = 0; a < NUM_ACTIONS && (row.legal >> a); ++a) file << row.probabilities[a] << " ";
+        file << '\n';
+    }
+
+    file.close();
+}
+
+// a row of n probabilities can choose the first n actions; rows for
+// gamestates outside the table are skipped
+Strategy load_strategy_from_file(const std::string &filename) {
+    Strategy strategy(NUM_GAMESTATES, StrategyRow());
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return strategy;
+    }
+
+    std::string line;
+    int skipped = 0;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        int eq_monster = -1, eq_strong = -1, eq_medium = -1, eq_weak = -1;
+        int position = -1, post_raises = -1, pre_raises = -1, multiway_int = 0;
+
+        iss >> eq_monster >> eq_strong >> eq_medium >> eq_weak
+            >> position >> post_raises >> pre_raises >> multiway_int;
+
+        StrategyRow row = {};
+        int n = 0;
+        float prob;
+        while (n < NUM_ACTIONS && iss >> prob) {
+            row.probabilities[n] = prob;
+            row.legal |= 1 << n++;
+        }
+
+        if (eq_monster < 0 || eq_monster >= NUM_EQUITIES || eq_strong < 0 || eq_strong >= NUM_EQUITIES
+            || eq_medium < 0 || eq_medium >= NUM_EQUITIES || eq_weak < 0 || eq_weak >= NUM_EQUITIES
+            || position < 0 || position >= NUM_PLAYERS || post_raises < 0 || post_raises > MAX_RAISES
+            || pre_raises < 0 || pre_raises > MAX_RAISES || (iss >> prob) || n == 0) {
+            skipped++;
+            continue;
+        }
+
+        Gamestate g = {
+            static_cast<Equity>(eq_monster),
+            static_cast<Equity>(eq_strong),
+            static_cast<Equity>(eq_medium),
+            static_cast<Equity>(eq_weak),
+            position,
+            post_raises,
+            pre_raises,
+            static_cast<bool>(multiway_int)
+        };
+
+        strategy[gamestate_index(g)] = row;
+    }
+    if (skipped) std::cerr << "Skipped " << skipped << " malformed rows in " << filename << std::endl;
+
+    return strategy;
+}
+
+bool save_strategy_binary(const Strategy &strategy, const std::string &filename) {
+    return save_strategy_file(filename, GTO_LAYOUT, gto_sections(strategy.data()));
+}
+
+StrategyRows load_strategy_binary(const std::string &filename) {
+    auto file = std::make_shared<MappedStrategyFile>();
+    if (!file->open(filename, GTO_LAYOUT, gto_sections(nullptr))) return nullptr;
+    return mapped_rows(file, 0);
+}
+
+bool save_checkpoint(const std::string &filename, const GtoCheckpoint &meta, const std::vector<uint8_t> &mutate,
+                     const std::vector<const StrategyRow *> &strategies) {
+    return save_strategy_file(filename, GTO_CHECKPOINT_LAYOUT, checkpoint_sections(&meta, mutate.data(), strategies));
+}
+
+bool load_checkpoint(const std::string &filename, GtoCheckpoint &meta,
+                     std::vector<uint8_t> &mutate, std::vector<StrategyRows> &strategies) {
+    int num_strategies = strategy_file_sections(filename, GTO_CHECKPOINT_LAYOUT) - 2;
+    if (num_strategies < 0) return false;
+    auto file = std::make_shared<MappedStrategyFile>();
+    std::vector<const StrategyRow *> expected(num_strategies, nullptr);
+    if (!file->open(filename, GTO_CHECKPOINT_LAYOUT, checkpoint_sections(nullptr, nullptr, expected))) return false;
+    GtoCheckpoint saved;
+    std::memcpy(&saved, file->section(0), sizeof(saved));
+    if (num_strategies != (saved.population ? saved.population : NUM_PLAYERS)) {
+        std::cerr << "Strategy file layout mismatch: " << filename << std::endl;
+        return false;
+    }
+    meta = saved;
+    const uint8_t *flags = static_cast<const uint8_t *>(file->section(1));
+    mutate.assign(flags, flags + num_strategies);
+    strategies.clear();
+    for (int i = 0; i < num_strategies; ++i) strategies.push_back(mapped_rows(file, 2 + i));
+    return true;
+}
+
+bool gto_text_to_binary(const std::string &text_file, const std::string &binary_file) {
+    if (!std::ifstream(text_file).is_open()) {
+        std::cerr << "Failed to open file: " << text_file << std::endl;
+        return false;
+    }
+    return save_strategy_binary(load_strategy_from_file(text_file), binary_file);
+}
+
+bool gto_binary_to_text(const std::string &binary_file, const std::string &text_file) {
+    MappedStrategyFile file;
+    if (!file.open(binary_file, GTO_LAYOUT, gto_sections(nullptr))) return false;
+    save_strategy_to_file(static_cast<const StrategyRow *>(file.section(0)), text_file);
+    return true;
+}
@@ -0,0 +1,169 @@
+#ifndef _GTO_STRATEGY_HPP
+#define _GTO_STRATEGY_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Gamestates and strategy tables of the 4-player game in gto.cpp, with their
+   text (strategy.txt) and binary (strategy_file.hpp) formats. */
+
+#define STRATEGY_TEXT_FILE "strategy.txt"
+#define STRATEGY_BINARY_FILE "strategy.bin"
+#define CHECKPOINT_FILE "gto_checkpoint.bin"
+
+const int NUM_PLAYERS = 4;
+
+enum Equity {
+    DESTROYED,  // 0-19
+    LOW,        // 20-39
+    NEUTRAL,    // 40-59
+    HIGH,       // 60-79
+    DOMINATION  // 80-100
+};
+const int NUM_EQUITIES = DOMINATION + 1;
+
+enum Action {
+    FOLD,
+    CALL, // call = check
+    RAISE_50,
+    RAISE_100,
+    ALL_IN,
+    NUM_ACTIONS
+};
+
+// raise counters saturate here; an all-in sets them straight to it
+const int MAX_RAISES = 4;
+
+struct Gamestate {
+    Equity equity_vs_monster;
+    Equity equity_vs_strong;
+    Equity equity_vs_medium;
+    Equity equity_vs_weak;
+    int position; // number of people who act after you reach betting round
+    int post_raises;
+    int pre_raises;
+    bool multiway;
+};
+
+const int NUM_GAMESTATES = NUM_EQUITIES * NUM_EQUITIES * NUM_EQUITIES * NUM_EQUITIES
+                         * NUM_PLAYERS * (MAX_RAISES + 1) * (MAX_RAISES + 1) * 2;
+
+// dense row index, fields taken most significant first in declaration order
+inline int gamestate_index(const Gamestate &g) {
+    int index = g.equity_vs_monster;
+    index = index * NUM_EQUITIES + g.equity_vs_strong;
+    index = index * NUM_EQUITIES + g.equity_vs_medium;
+    index = index * NUM_EQUITIES + g.equity_vs_weak;
+    index = index * NUM_PLAYERS + g.position;
+    index = index * (MAX_RAISES + 1) + g.post_raises;
+    index = index * (MAX_RAISES + 1) + g.pre_raises;
+    return index * 2 + g.multiway;
+}
+
+inline Gamestate gamestate_from_index(int index) {
+    Gamestate g;
+    g.multiway = index % 2;
+    index /= 2;
+    g.pre_raises = index % (MAX_RAISES + 1);
+    index /= MAX_RAISES + 1;
+    g.post_raises = index % (MAX_RAISES + 1);
+    index /= MAX_RAISES + 1;
+    g.position = index % NUM_PLAYERS;
+    index /= NUM_PLAYERS;
+    g.equity_vs_weak = static_cast<Equity>(index % NUM_EQUITIES);
+    index /= NUM_EQUITIES;
+    g.equity_vs_medium = static_cast<Equity>(index % NUM_EQUITIES);
+    index /= NUM_EQUITIES;
+    g.equity_vs_strong = static_cast<Equity>(index % NUM_EQUITIES);
+    g.equity_vs_monster = static_cast<Equity>(index / NUM_EQUITIES);
+    return g;
+}
+
+struct StrategyRow {
+    float probabilities[NUM_ACTIONS];
+    uint8_t legal; // bit a set if action a can be chosen, 0 while the row is unset
+};
+
+// one row per gamestate, NUM_GAMESTATES long
+typedef std::vector<StrategyRow> Strategy;
+
+inline uint8_t legal_actions(const Gamestate &g) {
+    if (g.pre_raises >= MAX_RAISES || g.post_raises >= MAX_RAISES) return 1 << FOLD | 1 << CALL;
+    return (1 << NUM_ACTIONS) - 1;
+}
+
+// NUM_GAMESTATES rows that stay where they are while any pointer to them
+// lives: a Strategy's, or a section of a mapped strategy file
+typedef std::shared_ptr<const StrategyRow> StrategyRows;
+
+/* A strategy as a read-only base table shared between copies, plus a sparse
+   overlay of the rows this copy has changed (an open-addressing hash table
+   that keeps its capacity when cleared). Copying one shares the base, so a
+   population member costs its overlay, kilobytes, rather than a table. The
+   base can be a mapped strategy file, which is only copied once a merge has
+   to write it. */
+class OverlayStrategy {
+public:
+    // rows are mutated once, as they are first copied into the overlay
+    bool mutant = false;
+
+    OverlayStrategy() {}
+    explicit OverlayStrategy(std::shared_ptr<Strategy> table)
+        : base(table, table->data()), writable(table->data()) {}
+    explicit OverlayStrategy(StrategyRows rows) : base(std::move(rows)) {}
+
+    const StrategyRow &base_row(int index) const { return base.get()[index]; }
+    const StrategyRow *base_table() const { return base.get(); }
+    // the overlay's row, nullptr if the base one is still in use
+    StrategyRow *find(int index);
+    // adds or replaces the overlay's row; the reference lasts until the next insert
+    StrategyRow &insert(int index, const StrategyRow &row);
+    int overlay_rows() const { return used; }
+
+    // the base with the overlay applied
+    Strategy flatten() const;
+    // folds the overlay into the base, in place when no one else shares it
+    // and it is a Strategy, and stops being a mutant
+    void merge();
+    // an unchanged copy of parent, which must have an empty overlay, that
+    // mutates what it touches; reuses this overlay's capacity
+    void become_mutant_of(const OverlayStrategy &parent);
+    // lets go of the base and empties the overlay, keeping its capacity
+    void clear();
+
+private:
+    StrategyRows base;
+    StrategyRow *writable = nullptr; // base when it is a Strategy's rows, only written by merge, when unshared
+    std::vector<int32_t> keys; // gamestate index, -1 when free
+    std::vector<StrategyRow> rows;
+    int used = 0;
+
+    int slot(int index) const;
+    void clear_overlay();
+};
+
+void save_strategy_to_file(const StrategyRow *strategy, const std::string &filename);
+Strategy load_strategy_from_file(const std::string &filename);
+
+bool save_strategy_binary(const Strategy &strategy, const std::string &filename);
+// the rows of the file's read-only mapping, which lasts as long as they do;
+// nullptr on failure
+StrategyRows load_strategy_binary(const std::string &filename);
+
+// training state between generations, saved with the players' or population
+// members' strategies and mutate flags, in order
+struct GtoCheckpoint {
+    int32_t generation;           // generations done
+    int32_t population;           // members, 0 outside population mode
+    uint64_t seed;                // rng restarts from this after the checkpoint
+};
+bool save_checkpoint(const std::string &filename, const GtoCheckpoint &meta, const std::vector<uint8_t> &mutate,
+                     const std::vector<const StrategyRow *> &strategies);
+// loads as many strategies as were saved, which meta.population tells, as
+// rows of one mapping of the file; nothing is touched on failure
+bool load_checkpoint(const std::string &filename, GtoCheckpoint &meta,
+                     std::vector<uint8_t> &mutate, std::vector<StrategyRows> &strategies);
+
+#endif
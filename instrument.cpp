@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "instrument.hpp"
+
+#if INSTRUMENTING
+
+namespace {
+
+const char *const COUNTER_NAMES[NUM_COUNTERS] = {
+    "dfs_nodes_preflop", "dfs_nodes_flop", "dfs_nodes_turn", "dfs_nodes_river",
+    "hands_evaluated", "strategy_lookups", "strategy_misses", "equity_pairs", "showdowns",
+    "traversal_ms", "update_ms", "equity_ms", "hand_ms"
+};
+
+std::mutex registry_mutex;
+// counters of the running threads; those of finished threads are summed into finished
+std::vector<ThreadCounters *> &running() {
+    static std::vector<ThreadCounters *> threads;
+    return threads;
+}
+uint64_t finished[NUM_COUNTERS];
+uint64_t reported[NUM_COUNTERS];
+
+} // namespace
+
+thread_local ThreadCounters thread_counters;
+
+ThreadCounters::ThreadCounters() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    running().push_back(this);
+}
+
+ThreadCounters::~ThreadCounters() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (int c = 0; c < NUM_COUNTERS; ++c) finished[c] += values[c];
+    std::vector<ThreadCounters *> &threads = running();
+    threads.erase(std::find(threads.begin(), threads.end(), this));
+}
+
+std::string counter_report() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::ostringstream out;
+    for (int c = 0; c < NUM_COUNTERS; ++c) {
+        uint64_t total = finished[c];
+        for (const ThreadCounters *t: running()) total += t->values[c];
+        uint64_t since = total - reported[c];
+        reported[c] = total;
+        if (!since) continue;
+        if (out.tellp() > 0) out << ' ';
+        out << COUNTER_NAMES[c] << '=';
+        if (c >= TRAVERSAL_TIME) out << since / 1e6;
+        else out << since;
+    }
+    return out.str();
+}
+
+#endif
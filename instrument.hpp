@@ -0,0 +1,80 @@
+#ifndef _INSTRUMENT_HPP
+#define _INSTRUMENT_HPP
+
+#include <cstdint>
+#include <string>
+
+/* Hot-path counters, for seeing where training time goes without a profiler.
+   Building with -DINSTRUMENT (and instrument.cpp) makes count_event and
+   ScopedTimer add to counters of the calling thread, which counter_report sums
+   over every thread. Without it both are empty inlines and compile away. */
+
+#ifdef INSTRUMENT
+#define INSTRUMENTING 1
+#include <chrono>
+#else
+#define INSTRUMENTING 0
+#endif
+
+enum Counter {
+    DFS_NODES_PREFLOP,  // Game::dfs decisions, one per street
+    DFS_NODES_FLOP,
+    DFS_NODES_TURN,
+    DFS_NODES_RIVER,
+    HANDS_EVALUATED,    // by evaluate_hand and evaluate_hands
+    STRATEGY_LOOKUPS,   // strategy rows a decision read
+    STRATEGY_MISSES,    // of those, rows created on the spot (default_strategy, random_probabilities)
+    EQUITY_PAIRS,       // (villain, runout) pairs get_equities scored
+    SHOWDOWNS,
+    // timers, in nanoseconds
+    TRAVERSAL_TIME,     // Game::run_traversals
+    UPDATE_TIME,        // Game::update_strategy
+    EQUITY_TIME,        // get_equities
+    HAND_TIME,          // gto.cpp play_round
+    NUM_COUNTERS
+};
+
+#if INSTRUMENTING
+
+struct ThreadCounters {
+    uint64_t values[NUM_COUNTERS] = {};
+    ThreadCounters();  // makes them visible to counter_report
+    ~ThreadCounters(); // leaves them to the totals of finished threads
+};
+
+extern thread_local ThreadCounters thread_counters;
+
+inline void count_event(Counter counter, uint64_t n = 1) { thread_counters.values[counter] += n; }
+
+// adds the time until it goes out of scope to a timer counter
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Counter counter) : counter(counter), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+        count_event(counter, elapsed.count());
+    }
+
+private:
+    Counter counter;
+    std::chrono::steady_clock::time_point start;
+};
+
+// "name=value" for every counter that moved since the previous report, summed
+// over all threads (timers in ms); call it while no other thread is counting
+std::string counter_report();
+
+#else
+
+inline void count_event(Counter, uint64_t = 1) {}
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Counter) {}
+};
+
+inline std::string counter_report() { return ""; }
+
+#endif
+
+#endif
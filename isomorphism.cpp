@@ -0,0 +1,39 @@
+#include <algorithm>
+
+#include "isomorphism.hpp"
+
+const int SUIT_PERMUTATIONS[NUM_SUIT_PERMUTATIONS][4] = {
+    {0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 1, 3}, {0, 2, 3, 1},
+    {0, 3, 1, 2}, {0, 3, 2, 1}, {1, 0, 2, 3}, {1, 0, 3, 2},
+    {1, 2, 0, 3}, {1, 2, 3, 0}, {1, 3, 0, 2}, {1, 3, 2, 0},
+    {2, 0, 1, 3}, {2, 0, 3, 1}, {2, 1, 0, 3}, {2, 1, 3, 0},
+    {2, 3, 0, 1}, {2, 3, 1, 0}, {3, 0, 1, 2}, {3, 0, 2, 1},
+    {3, 1, 0, 2}, {3, 1, 2, 0}, {3, 2, 0, 1}, {3, 2, 1, 0},
+};
+
+int canonical_weight(CardMask board) {
+    CardMask images[NUM_SUIT_PERMUTATIONS];
+    for (int p = 0; p < NUM_SUIT_PERMUTATIONS; ++p) {
+        images[p] = permute_suits(board, SUIT_PERMUTATIONS[p]);
+        if (images[p] < board) return 0;
+    }
+    std::sort(images, images + NUM_SUIT_PERMUTATIONS);
+    return std::unique(images, images + NUM_SUIT_PERMUTATIONS) - images;
+}
+
+/* Masks compare from the highest suit lane down, so the smallest board puts
+   the suit with the fewest, lowest board ranks in the top lane, and so on
+   down; suits the board cannot tell apart are ordered by their hole ranks the
+   same way. That is a sort of the four suits by (board ranks, hole ranks),
+   rather than a search over all 24 permutations. */
+CanonicalSpot canonical_spot(CardMask hole, CardMask board) {
+    uint64_t keys[4];
+    for (int s = 0; s < 4; ++s) keys[s] = uint64_t(suit_ranks(board, s)) << 16 | suit_ranks(hole, s);
+    std::sort(keys, keys + 4);
+    CanonicalSpot spot = {0, 0};
+    for (int s = 0; s < 4; ++s) {
+        spot.board |= CardMask(keys[s] >> 16) << (16 * (3 - s));
+        spot.hole |= CardMask(keys[s] & 0xFFFF) << (16 * (3 - s));
+    }
+    return spot;
+}
@@ -0,0 +1,37 @@
+#ifndef _ISOMORPHISM_HPP
+#define _ISOMORPHISM_HPP
+
+#include "cards.hpp"
+
+/* Suit isomorphism. Relabelling the suits of a spot gives one that plays out
+   the same against suit-symmetric ranges, so work on a spot can be shared by
+   its whole class, up to 24 spots. A class is represented by its smallest
+   member: the smallest board under the 24 suit permutations, and among the
+   permutations that give that board, the smallest hole cards. */
+
+#define NUM_SUIT_PERMUTATIONS 24
+
+// permutation p sends suit s to SUIT_PERMUTATIONS[p][s]; the identity is first
+extern const int SUIT_PERMUTATIONS[NUM_SUIT_PERMUTATIONS][4];
+
+inline CardMask permute_suits(CardMask cards, const int *perm) {
+    CardMask out = 0;
+    for (int s = 0; s < 4; ++s) out |= CardMask(suit_ranks(cards, s)) << (16 * perm[s]);
+    return out;
+}
+
+// 0 if the board is not the smallest mask of its class, otherwise the number
+// of distinct boards in the class
+int canonical_weight(CardMask board);
+
+struct CanonicalSpot {
+    CardMask hole;
+    CardMask board;
+    bool operator==(const CanonicalSpot &other) const { return hole == other.hole && board == other.board; }
+};
+
+// the smallest member of the class of (hole, board); spots on one board all
+// get the same canonical board
+CanonicalSpot canonical_spot(CardMask hole, CardMask board);
+
+#endif
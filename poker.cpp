@@ -1,160 +1,227 @@
+// compile with g++ -std=c++17 -O2 -Wall -pthread poker.cpp poker_strategy.cpp strategy_file.cpp evaluator.cpp alloc_count.cpp telemetry.cpp -o poker
+// (add -DCOUNT_ALLOCATIONS to print the heap allocations of every update's traversals,
+// -DINSTRUMENT instrument.cpp to print the hot-path counters of instrument.hpp at the end)
+// usage: ./poker [--threads N] [--mccfr] [--cfr batch|plus|linear|discounted] [--target MBB]
+//                [--seed S] [--resume] [--telemetry FILE]
+//        (--threads 0 uses every core, --cfr defaults to plus, --target stops
+//        training once exploitability is at most MBB mbb/hand, --resume picks
+//        up from poker_checkpoint.bin with the settings saved in it; runs with
+//        the same --seed and --threads are identical; --telemetry writes a
+//        JSON line of metrics per update to FILE, see telemetry.hpp)
+// strategy_convert heads-up p0_strat.bin p0_strat gives the old text dump
+
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <random>
+#include <string>
+#include <thread>
 
+#include "alloc_count.hpp"
+#include "instrument.hpp"
 #include "poker.hpp"
+#include "telemetry.hpp"
 
 std::random_device rd;
-std::default_random_engine rng(rd());
 constexpr int RUNOUTS = 1;
-
-Game::Game() {
+constexpr int MAX_UPDATES = 60;
+constexpr int TRAVERSALS_PER_UPDATE = 10000;
+// with a target, exploitability is measured every this many updates on this
+// many deals; the deals are the same for every measurement
+constexpr int EXPLOITABILITY_INTERVAL = 10;
+constexpr int EXPLOITABILITY_DEALS = 5000;
+constexpr unsigned EXPLOITABILITY_SEED = 0x5eed;
+constexpr int BEST_RESPONSE_PASSES = 8;
+constexpr int CHECKPOINT_INTERVAL = 10;
+const std::string CHECKPOINT_FILE = "poker_checkpoint.bin";
+
+Game::Game() : rng(rd()) {
     top_card_index = 51;
     small_blind = 1;
     main_character = 0;
+    updates = 0;
+    traversal_allocations = 0;
+    last_update = UpdateStats{};
+    telemetry = nullptr;
+    external_sampling = false;
+    regret_update = CFR_PLUS;
     pot = 0;
     pre_raises = 0;
     post_raises = 0;
-    int idx = 0;
-    for (int j = Suit::HEART; j <= Suit::CLUB; j++) {
-        for (int i = 2; i <= 14; i++) {
-            deck[idx++] = {i, static_cast<Suit>(j)};
-        }
-    }
+    community_cards = 0;
+    live_cards(0, deck);
 
     for (int i = 0; i < NUM_PLAYERS; ++i) {
         players[i] = Player(draw(), draw());
     }
+    precompute_deal();
 }
 
-Card Game::draw() {
+int Game::draw() {
     return deck[top_card_index--];
 }
 
+// only the cards a deal can use are shuffled to the top: hole cards and board
 void Game::reset_and_deal() {
     top_card_index = 51;
-    std::shuffle(deck, deck+52, rng);
+    deal_to_top(deck, 52, 2 * NUM_PLAYERS + 5, rng);
     for (int i = 0; i < NUM_PLAYERS; i++) {
-        players[i].hole_cards[0] = draw();
-        players[i].hole_cards[1] = draw();
+        players[i].hole_cards = card_mask(draw());
+        players[i].hole_cards |= card_mask(draw());
     }
+    precompute_deal();
 }
 
-void Game::run_game() {
-    // Pre flop first take blinds
+void Game::restart_deals(uint64_t seed, uint64_t stream) {
+    std::sort(deck, deck + 52);
+    rng.seed(seed, stream);
+    reset_and_deal();
+}
+
+void Game::precompute_deal() {
+    // dfs deals the board straight off the top of the deck and puts it back on
+    // undo, so every line of this deal sees the same flop, turn and river
+    CardMask board = 0;
+    for (int street = PREFLOP; street < NUM_STREETS; ++street) {
+        if (street == FLOP) {
+            for (int i = 0; i < 3; ++i) board |= card_mask(deck[top_card_index - i]);
+        }
+        else if (street > FLOP) {
+            board |= card_mask(deck[top_card_index - street - 1]);
+        }
+        for (int i = 0; i < NUM_PLAYERS; ++i) {
+            deal_states[i][street] = calc_gamestate(i, board);
+        }
+    }
+    CardMask holes[NUM_PLAYERS];
+    for (int i = 0; i < NUM_PLAYERS; ++i) holes[i] = players[i].hole_cards;
+    evaluate_hands(holes, board, showdown_scores, NUM_PLAYERS);
+}
+
+void Game::post_blinds() {
     players[0].chips -= small_blind;
     players[0].bet_made += small_blind;
     players[1].chips -= small_blind * 2;
     players[1].bet_made += small_blind * 2;
     pot += small_blind * 3;
     current_bet = small_blind * 2;
-    
-    for (int num_updates = 1; num_updates <= 60; ++num_updates) {
-        for (int games_per_update = 1; games_per_update <= 10000; ++games_per_update) {
-            dfs(-1, 0);
-            reset_and_deal();
-        }
+}
+
+void Game::run_game(int num_threads, float exploitability_target) {
+    // Pre flop first take blinds
+    post_blinds();
+
+    bool target_reached = false;
+    while (updates < MAX_UPDATES && !target_reached) {
+        auto start = std::chrono::steady_clock::now();
+        if (num_threads > 1) run_parallel_traversals(TRAVERSALS_PER_UPDATE, num_threads);
+        else run_traversals(TRAVERSALS_PER_UPDATE);
+        std::chrono::duration<double> traversal_time = std::chrono::steady_clock::now() - start;
         update_strategy();
         main_character = (main_character + 1) % NUM_PLAYERS;
+        updates++;
+        std::vector<TelemetryField> metrics = {
+            {"update", double(updates)},
+            {"traversals_per_s", TRAVERSALS_PER_UPDATE / traversal_time.count()},
+            {"states_touched", double(last_update.states_touched)},
+            {"strategy_change", last_update.strategy_change},
+            {"mean_positive_regret", last_update.mean_positive_regret},
+        };
+        if (ALLOCATION_COUNTING) {
+            std::cout << "update " << updates << ": " << traversal_allocations << " heap allocations in traversals" << std::endl;
+            traversal_allocations = 0;
+        }
+
+        if (updates % CHECKPOINT_INTERVAL == 0) {
+            uint64_t seed = rng();
+            restart_deals(seed);
+            save_checkpoint(CHECKPOINT_FILE, seed);
+        }
+        if (exploitability_target > 0 && updates % EXPLOITABILITY_INTERVAL == 0) {
+            float mbb = exploitability(EXPLOITABILITY_DEALS, num_threads);
+            std::cout << "update " << updates << ": exploitability " << mbb << " mbb/hand" << std::endl;
+            metrics.push_back({"exploitability_mbb", mbb});
+            target_reached = mbb <= exploitability_target;
+        }
+        if (telemetry) telemetry->record(std::move(metrics));
     }
-    players[0].save_strategy_to_file("p0_strat");
-    players[1].save_strategy_to_file("p1_strat");
+    players[0].save_strategy_binary("p0_strat.bin");
+    players[1].save_strategy_binary("p1_strat.bin");
+    if (INSTRUMENTING) std::cout << "counters " << counter_report() << std::endl;
     
 
 }
 
-bool Game::all_folded() {
-    int active_players = 0;
-    for (Player &p: players) {
-        if (!p.folded) active_players++;
+void Game::run_traversals(int games) {
+    ScopedTimer timer(TRAVERSAL_TIME);
+    uint64_t allocations = thread_allocations();
+    for (int i = 0; i < games; ++i) {
+        dfs(-1, 0);
+        reset_and_deal();
     }
-    return active_players == 1;
+    traversal_allocations += thread_allocations() - allocations;
 }
-int Game::evaluate_cards(int player) {
-    Player &p = players[player];
-    std::vector<Card> cards;
-    cards.push_back(p.hole_cards[0]);
-    cards.push_back(p.hole_cards[1]);
-    for (Card &c: community_cards) cards.push_back(c);
-
-    int rank_count[15] = {}; // 2-14, 0 and 1 not used
-    int suit_count[4] = {};
-
-    for (auto& c : cards) {
-        rank_count[c.rank]++;
-        suit_count[c.suit]++;
-    }
-
-    // Sort cards by rank descending
-    std::sort(cards.begin(), cards.end(), [](const Card& a, const Card& b) {
-        return a.rank > b.rank;
-    });
-
-    for (int suit = 0; suit < 4; ++suit) {
-        if (suit_count[suit] >= 5) {
-            int straight_count = -1;
-            int last_rank = -1;
-            for (Card &c: cards) {
-                if (c.suit == suit) {
-                    if (last_rank - 1 == c.rank) {
-                        if(++straight_count == 5) return 8000000 + c.rank + 4;
-                        last_rank--;
-                    }
-                    else {
-                        straight_count = 1;
-                        last_rank = c.rank;
-                    }
-                }
-            }
-            for (Card &c: cards) {
-                if (c.suit == suit) return 5000000 + c.rank;
-            }
-        }
-    }
 
-    std::vector<std::pair<int, int>> freq_val_pairs;
-    for (int rank = 2; rank <= 14; ++rank) {
-        if (rank_count[rank] > 0) {
-            freq_val_pairs.push_back({rank_count[rank], rank});
+/* Every worker is a copy of this game, so it owns its deck, pot, chips and
+   board, and starts from the strategies as they are now. Strategies only
+   change in update_strategy, so the copies are an exact snapshot for the whole
+   batch. What a worker learns (ev, and the states it gave a default strategy)
+   lands in its own players and is merged back once all workers are done.
+   Worker t draws from stream t of a seed taken from rng once per batch. */
+void Game::run_parallel_traversals(int games, int num_threads) {
+    std::vector<Game> workers(num_threads, *this);
+    uint64_t batch_seed = rng();
+    for (int t = 0; t < num_threads; ++t) {
+        Game &worker = workers[t];
+        for (Player &p: worker.players) {
+            std::fill(p.ev.begin(), p.ev.end(), ActionRow{});
+            std::fill(p.ev_touched.begin(), p.ev_touched.end(), 0);
+            std::fill(p.reach.begin(), p.reach.end(), 0.0f);
         }
+        worker.traversal_allocations = 0;
+        worker.rng.seed(batch_seed, t);
+        worker.reset_and_deal();
     }
-    std::sort(freq_val_pairs.begin(), freq_val_pairs.end(), [](const auto & a, const auto & b){
-        if (a.first != b.first) return a.first > b.first;
-        return a.second > b.second;
-    });
-
-    if (freq_val_pairs[0].first == 4) return 7000000 + freq_val_pairs[0].second;
-    if (freq_val_pairs[0].first == 3 && freq_val_pairs[1].first == 2) {
-        return 6000000 + freq_val_pairs[0].second * 10 + freq_val_pairs[1].second;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        int share = games / num_threads + (t < games % num_threads);
+        threads.emplace_back([&workers, t, share]() { workers[t].run_traversals(share); });
     }
+    for (std::thread &thread: threads) thread.join();
+    for (Game &worker: workers) merge_traversals(worker);
+}
 
-    // check straight
-    int straight_count = -1;
-    int last_rank = -1;
-    for (Card &c: cards) {
-        if (c.rank == last_rank) continue;
-        if (last_rank - 1 == c.rank) {
-            if(++straight_count == 5) return 5000000 + c.rank + 4;
-            last_rank--;
-        }
-        else {
-            straight_count = 1;
-            last_rank = c.rank;
+void Game::merge_traversals(const Game &worker) {
+    traversal_allocations += worker.traversal_allocations;
+    for (int i = 0; i < NUM_PLAYERS; ++i) {
+        Player &p = players[i];
+        const Player &w = worker.players[i];
+        for (int index = 0; index < NUM_GAMESTATES; ++index) {
+            if (w.seen[index] && !p.seen[index]) {
+                p.strategy[index] = w.strategy[index];
+                p.seen[index] = 1;
+            }
+            if (!w.ev_touched[index]) continue;
+            p.ev_touched[index] = 1;
+            p.reach[index] += w.reach[index];
+            for (int a = 0; a < NUM_ACTIONS; ++a) p.ev[index][a] += w.ev[index][a];
         }
     }
+}
 
-    if (freq_val_pairs[0].first == 3) {
-        return 3000000 + freq_val_pairs[0].second * 100 + freq_val_pairs[1].second * 10 + freq_val_pairs[2].second;
-    }
-    if (freq_val_pairs[0].first == 2 && freq_val_pairs[1].first == 2) {
-        return 2000000 + freq_val_pairs[0].second * 100 + freq_val_pairs[1].second * 10 + freq_val_pairs[2].second;
-    }
-    if (freq_val_pairs[0].first == 2) {
-        return 1000000 + freq_val_pairs[0].second * 1000 + freq_val_pairs[1].second * 100 + freq_val_pairs[2].second * 10 + freq_val_pairs[3].second;
+bool Game::all_folded() {
+    int active_players = 0;
+    for (Player &p: players) {
+        if (!p.folded) active_players++;
     }
-    return freq_val_pairs[0].second * 10000 + freq_val_pairs[1].second * 1000 + freq_val_pairs[2].second * 100 + freq_val_pairs[3].second * 10 + freq_val_pairs[4].second;
+    return active_players == 1;
+}
+int Game::evaluate_cards(int player, CardMask board) {
+    return evaluate_hand(players[player].hole_cards | board);
 }
 float Game::showdown() {
+    count_event(SHOWDOWNS);
     int best_score = 0;
     int number_of_winners = 0;
     int main_player_score = 1e9;
@@ -162,7 +229,7 @@ float Game::showdown() {
     for (int i = 0; i < NUM_PLAYERS; ++i) {
         Player &p = players[i];
         if (p.folded) continue;
-        int score = evaluate_cards(i);
+        int score = showdown_scores[i];
         if (i == main_character) main_player_score = score;
         if (score > best_score) {
             best_score = score;
@@ -176,105 +243,46 @@ float Game::showdown() {
     return (players[main_character].chips + (pot / number_of_winners) - INITIAL_CHIPS);
 }
 
-GameState Game::calc_gamestate(int player) {
+GameState Game::calc_gamestate(int player, CardMask board) {
     Player &p = players[player];
-    if (community_cards.empty()) {
-        int rank1 = p.hole_cards[0].rank;
-        int rank2 = p.hole_cards[1].rank;
+    CardMask hole = p.hole_cards;
+    int hole1 = pop_card(hole);
+    int hole2 = pop_card(hole);
+    if (board == 0) {
+        int rank1 = card_rank(hole1) + 2;
+        int rank2 = card_rank(hole2) + 2;
         if (rank1 < rank2) std::swap(rank1, rank2);
-        bool suited = p.hole_cards[0].suit == p.hole_cards[1].suit;
-        return GameState(rank1, rank2, suited, pre_raises);
-    }
-    int score = evaluate_cards(player);
-    int cards_that_beat_us = 0;
-
-    auto evaluate_suitless = [&](int a, int b) {
-        std::vector<int> cards = {a, b};
-        int rank_count[15] = {};
-        rank_count[a]++;
-        rank_count[b]++;
-        for (Card &c: community_cards) {
-            rank_count[c.rank]++;
-            cards.push_back(c.rank);
-        }
-        std::sort(cards.begin(), cards.end(), [](const int &a, const int &b){return a > b;});
-        std::vector<std::pair<int, int>> freq_val_pairs;
-        for (int rank = 2; rank <= 14; ++rank) {
-            if (rank_count[rank] > 0) {
-                freq_val_pairs.push_back({rank_count[rank], rank});
-            }
-        }
-        std::sort(freq_val_pairs.begin(), freq_val_pairs.end(), [](const auto & a, const auto & b){
-            if (a.first != b.first) return a.first > b.first;
-            return a.second > b.second;
-        });
-
-        if (freq_val_pairs[0].first == 4) return 7000000 + freq_val_pairs[0].second;
-        if (freq_val_pairs[0].first == 3 && freq_val_pairs[1].first == 2) {
-            return 6000000 + freq_val_pairs[0].second * 10 + freq_val_pairs[1].second;
-        }
-
-        // check straight
-        int straight_count = -1;
-        int last_rank = -1;
-        for (int &c: cards) {
-            if (c == last_rank) continue;
-            if (last_rank - 1 == c) {
-                if(++straight_count == 5) return 5000000 + c + 4;
-                last_rank--;
-            }
-            else {
-                straight_count = 1;
-                last_rank = c;
-            }
-        }
-
-        if (freq_val_pairs[0].first == 3) {
-            return 3000000 + freq_val_pairs[0].second * 100 + freq_val_pairs[1].second * 10 + freq_val_pairs[2].second;
-        }
-        if (freq_val_pairs[0].first == 2 && freq_val_pairs[1].first == 2) {
-            return 2000000 + freq_val_pairs[0].second * 100 + freq_val_pairs[1].second * 10 + freq_val_pairs[2].second;
-        }
-        if (freq_val_pairs[0].first == 2) {
-            return 1000000 + freq_val_pairs[0].second * 1000 + freq_val_pairs[1].second * 100 + freq_val_pairs[2].second * 10 + freq_val_pairs[3].second;
-        }
-        return freq_val_pairs[0].second * 10000 + freq_val_pairs[1].second * 1000 + freq_val_pairs[2].second * 100 + freq_val_pairs[3].second * 10 + freq_val_pairs[4].second;
-
-    };
-    for (int high = 2; high <= 14; ++high) {
-        for (int low = 2; low <= high; ++low) {
-            if (evaluate_suitless(high, low) > score) cards_that_beat_us++;
-        }
+        bool suited = card_suit(hole1) == card_suit(hole2);
+        return GameState(rank1, rank2, suited, 0);
     }
+    int score = evaluate_cards(player, board);
+    int cards_that_beat_us = rank_combos_that_beat(board, score);
     int straight_draws = 0;
     bool flush_draw = false;
 
     int flush_possible = 0;
-    int suit_count[4] = {};
-    for (Card &c: community_cards) {
-        if(++suit_count[c.suit] >= 3) flush_possible = 1;
-    }
     int suit = -1;
-    if (++suit_count[p.hole_cards[0].suit] >= 4) suit = p.hole_cards[0].suit;
-    if (++suit_count[p.hole_cards[1].suit] >= 4) suit = p.hole_cards[1].suit;
+    for (int s = 0; s < 4; ++s) {
+        if (num_cards(suit_ranks(board, s)) >= 3) flush_possible = 1;
+        int in_suit = num_cards(suit_ranks(board | p.hole_cards, s));
+        if (suit_ranks(p.hole_cards, s) && in_suit >= 4) suit = s;
+    }
 
     if (flush_possible) {
-        if (score < 5000000) {
-            if (community_cards.size() < 5 && suit != -1) flush_draw = true;
+        if (hand_category(score) < FLUSH) {
+            if (num_cards(board) < 5 && suit != -1) flush_draw = true;
         }
     }
-    if (score < 4000000) {
+    if (hand_category(score) < STRAIGHT) {
         // count straight draws
-        int ranks[15];
-        ranks[p.hole_cards[0].rank] = 1;
-        ranks[p.hole_cards[1].rank] = 1;
-        for (Card &c: community_cards) ranks[c.rank] = 1;
-        if (ranks[14]) ranks[1] = 1;
+        // bit r set if rank r (2-14) is held, ace also counts as 1
+        uint32_t ranks = rank_set(p.hole_cards | board) << 2;
+        if (ranks >> 14 & 1) ranks |= 1 << 1;
         int l = 1; 
         int r = 1;
         int gap = -1;
         while (r <= 14) {
-            if (ranks[r] == 0) {
+            if ((ranks >> r & 1) == 0) {
                 if (gap != -1) l = r;
                 gap = r;
                 r++;
@@ -283,58 +291,111 @@ GameState Game::calc_gamestate(int player) {
                 straight_draws++;
                 l = gap + 1;
             }
-            if (ranks[r]) r++;
+            if (ranks >> r & 1) r++;
         }
     }
-    return GameState(cards_that_beat_us, flush_possible, straight_draws, flush_draw, pre_raises, post_raises);
+    return GameState(cards_that_beat_us, flush_possible, straight_draws, flush_draw, 0, 0);
 }
 
-void Game::default_strategy(Player &p, const GameState &g) {
-    if (pre_raises < 2 && post_raises < 2) {
-        p.strategy[g][0] = 0.333333;
-        p.strategy[g][1] = 0.333333;
-        p.strategy[g][2] = 0.333333;
-    }
-    else {
-        p.strategy[g][0] = 0.5f;
-        p.strategy[g][1] = 0.5f;
-        p.strategy[g][2] = 0.0f;
+// what a state plays before it has a strategy of its own
+static ActionRow default_row(int index) {
+    GameState g = state_from_index(index);
+    if (g.preflop_raises < 2 && g.post_raises < 2) return ActionRow{{0.333333f, 0.333333f, 0.333333f, 0.0f}};
+    return ActionRow{{0.5f, 0.5f, 0.0f, 0.0f}};
+}
+
+void Game::default_strategy(Player &p, int index) {
+    p.strategy[index] = default_row(index);
+    p.ev[index] = ActionRow{};
+    p.seen[index] = 1;
+    p.ev_touched[index] = 1;
+}
+
+// one legal action drawn in proportion to the strategy; folding needs a bet to
+// face and raising needs the raise cap not to be hit
+int Game::sample_action(const ActionRow &strategy, bool can_fold, bool can_raise) {
+    float weights[NUM_ACTIONS] = {can_fold ? strategy[FOLD] : 0.0f, strategy[CALL], can_raise ? strategy[RAISE] : 0.0f};
+    float total = weights[FOLD] + weights[CALL] + weights[RAISE];
+    if (total <= 0) return CALL;
+    float x = std::uniform_real_distribution<float>(0.0f, total)(rng);
+    for (int i = 0; i < NUM_ACTIONS - 1; ++i) {
+        if (x < weights[i]) return i;
+        x -= weights[i];
     }
-    p.ev[g][0] = 0.0f;
-    p.ev[g][1] = 0.0f;
-    p.ev[g][2] = 0.0f;
+    return weights[NUM_ACTIONS - 1] > 0 ? NUM_ACTIONS - 1 : CALL;
 }
 
+/* Regret matching on cumulative regrets. The batch regrets r of update t
+   (counting from 1) are folded in as
+     BATCH_REGRETS    R = r, the latest batch only
+     CFR_PLUS         R = max(R + r, 0)
+     LINEAR_CFR       R += t r
+     DISCOUNTED_CFR   R *= t^1.5 / (t^1.5 + 1) where positive, 1/2 elsewhere, then R += r
+   and the strategy that played the batch enters the average with weight
+   reach * t (reach * t^2 for DISCOUNTED_CFR). */
 void Game::update_strategy() {
+    ScopedTimer timer(UPDATE_TIME);
     Player &p = players[main_character];
+    int t = ++p.iterations;
+    float positive_discount = std::pow(t, 1.5) / (std::pow(t, 1.5) + 1);
+    float negative_discount = 0.5f;
+    float average_weight = regret_update == DISCOUNTED_CFR ? float(t) * t : float(t);
+    int touched = 0;
+    double strategy_change = 0;
+    double positive_regret = 0;
+
+    for (int index = 0; index < NUM_GAMESTATES; ++index) {
+        if (!p.seen[index]) continue;
+        GameState g = state_from_index(index);
+        int n = (g.preflop_raises >= 2 || g.post_raises >= 2) ? 2 : 3; // hmmmm
+        ActionRow &regret = p.regret[index];
+        // discounting applies to every state; it scales all positive regrets
+        // alike, so unvisited strategies stay as they are
+        if (regret_update == DISCOUNTED_CFR) {
+            for (int i = 0; i < n; ++i) regret[i] *= regret[i] > 0 ? positive_discount : negative_discount;
+        }
+        if (!p.ev_touched[index]) continue;
+
+        ActionRow &evs = p.ev[index];
+        ActionRow &strategy = p.strategy[index];
+        ActionRow before = strategy;
+        touched++;
+        for (int i = 0; i < n; ++i) p.average[index][i] += average_weight * p.reach[index] * strategy[i];
 
-    for (auto &[g, evs]: p.ev) {
         double avg_ev = 0;
-        int n = (g.preflop_raises >= 2 || g.post_raises >= 2) ? 2 : 3; // hmmmm
         for (int i = 0; i < n; ++i) {
-            avg_ev += p.strategy[g][i] * evs[i];
+            avg_ev += strategy[i] * evs[i];
         }
         double sum_pos_regret = 0;
         for (int i = 0; i < n; ++i) {
-            auto &e_value = evs[i];
-            if (e_value - avg_ev > 0) sum_pos_regret += e_value - avg_ev;
+            float r = evs[i] - avg_ev;
+            if (regret_update == BATCH_REGRETS) regret[i] = r;
+            else if (regret_update == CFR_PLUS) regret[i] = std::max(regret[i] + r, 0.0f);
+            else if (regret_update == LINEAR_CFR) regret[i] += t * r;
+            else regret[i] += r;
+            if (regret[i] > 0) sum_pos_regret += regret[i];
         }
         if (sum_pos_regret == 0) {
-            default_strategy(p, g);
+            default_strategy(p, index);
         }
         else {
             for (int i = 0; i < n; ++i) {
-                float e_value = evs[i];
-                if (e_value - avg_ev <= 0) p.strategy[g][i] = 0.0f;
-                else p.strategy[g][i] = (e_value - avg_ev) / sum_pos_regret;
+                strategy[i] = regret[i] > 0 ? regret[i] / sum_pos_regret : 0.0f;
             }
         }
-        // for (auto &e: evs) e = 0.0f;
+        for (int i = 0; i < NUM_ACTIONS; ++i) strategy_change += std::abs(strategy[i] - before[i]);
+        positive_regret += sum_pos_regret;
     }
-    p.ev.clear();
+    last_update = {touched, float(strategy_change), touched ? float(positive_regret / touched) : 0.0f};
+    std::fill(p.ev.begin(), p.ev.end(), ActionRow{});
+    std::fill(p.ev_touched.begin(), p.ev_touched.end(), 0);
+    std::fill(p.reach.begin(), p.reach.end(), 0.0f);
 }
 
-float Game::dfs(int last_aggressor, int player_turn) {
+/* opp_reach is the chance the opponent plays to this node and own_reach the
+   chance the traverser (main_character) does. The traverser's ev rows collect
+   opp_reach-weighted action values, its reach rows own_reach for averaging. */
+float Game::dfs(int last_aggressor, int player_turn, float opp_reach, float own_reach) {
     if (all_folded()) {
         float ev = (
             players[main_character].folded
@@ -346,13 +407,13 @@ float Game::dfs(int last_aggressor, int player_turn) {
     int undo_community_cards = 0;
 
     if (last_aggressor == player_turn) {
-        if (community_cards.empty()) {
+        if (community_cards == 0) {
             for (int i = 0; i < 3; ++i)
-                community_cards.push_back(draw());
+                community_cards |= card_mask(draw());
             undo_community_cards = 3;
         }
-        else if (community_cards.size() < 5) {
-            community_cards.push_back(draw());
+        else if (num_cards(community_cards) < 5) {
+            community_cards |= card_mask(draw());
             undo_community_cards = 1;
         }
         else {
@@ -378,29 +439,54 @@ float Game::dfs(int last_aggressor, int player_turn) {
 
     // --- Skip folded players ---
     if (curr_player.folded)
-        return dfs(last_aggressor, nxt_player);
-
-    auto state = calc_gamestate(player_turn);
-    if (curr_player.strategy.find(state) == curr_player.strategy.end())
-        default_strategy(curr_player, state);
+        return dfs(last_aggressor, nxt_player, opp_reach, own_reach);
+
+    int street = community_cards == 0 ? PREFLOP : num_cards(community_cards) - 2;
+    count_event(Counter(DFS_NODES_PREFLOP + street));
+    GameState state = deal_states[player_turn][street];
+    state.preflop_raises = pre_raises;
+    state.post_raises = post_raises;
+    int index = state_index(state);
+    count_event(STRATEGY_LOOKUPS);
+    if (!curr_player.seen[index]) {
+        count_event(STRATEGY_MISSES);
+        default_strategy(curr_player, index);
+    }
+    ActionRow &strategy = curr_player.strategy[index];
+    ActionRow &evs = curr_player.ev[index];
+    bool traverser = main_character == player_turn;
+    if (traverser) {
+        curr_player.ev_touched[index] = 1;
+        curr_player.reach[index] += own_reach;
+    }
 
     float total_ev = 0.0f;
     int to_call = current_bet - curr_player.bet_made;
 
+    // external sampling walks only the drawn action, at full weight
+    int sampled = -1;
+    if (external_sampling && main_character != player_turn)
+        sampled = sample_action(strategy, to_call > 0, pre_raises < 2 && post_raises < 2);
+
     // --- Loop over actions ---
     for (int rep = 0; rep < RUNOUTS; ++rep) {
     for (int i = 0; i < NUM_ACTIONS; i++) {
+        if (sampled != -1 && i != sampled) continue;
+        float weight = sampled == -1 ? strategy[i] : 1.0f;
+        // reach of the child node
+        float child_opp = traverser ? opp_reach : opp_reach * weight;
+        float child_own = traverser ? own_reach * weight : own_reach;
         if (i == FOLD && to_call > 0) {
-            if (main_character == player_turn) {
+            if (traverser) {
                 float ev = curr_player.chips - INITIAL_CHIPS;
-                curr_player.ev[state][i] += ev;
-                total_ev += ev;
+                evs[i] += opp_reach * ev;
+                total_ev += weight * ev;
                 continue;
             }
 
             curr_player.folded = true;
-            float ev = dfs(last_aggressor, nxt_player) * curr_player.strategy[state][i];
-            total_ev += ev;
+            float ev = dfs(last_aggressor, nxt_player, child_opp, child_own);
+            total_ev += weight * ev;
             curr_player.folded = false;
         }
         else if (i == CALL) {
@@ -408,17 +494,17 @@ float Game::dfs(int last_aggressor, int player_turn) {
             curr_player.bet_made += to_call;
             curr_player.chips -= to_call;
 
-            float ev = dfs(last_aggressor, nxt_player) * curr_player.strategy[state][i];
-            if (main_character == player_turn)
-                curr_player.ev[state][i] += ev;
-            total_ev += ev;
+            float ev = dfs(last_aggressor, nxt_player, child_opp, child_own);
+            if (traverser)
+                evs[i] += opp_reach * ev;
+            total_ev += weight * ev;
 
             pot -= to_call;
             curr_player.bet_made -= to_call;
             curr_player.chips += to_call;
         }
         else if (i == RAISE && pre_raises < 2 && post_raises < 2) {
-            bool preflop = community_cards.empty();
+            bool preflop = community_cards == 0;
             if (preflop) pre_raises++;
             else post_raises++;
 
@@ -430,10 +516,10 @@ float Game::dfs(int last_aggressor, int player_turn) {
             current_bet += bet - to_call;
             curr_player.chips -= bet;
 
-            float ev = dfs(new_aggressor, nxt_player) * curr_player.strategy[state][i];
-            if (main_character == player_turn)
-                curr_player.ev[state][i] += ev;
-            total_ev += ev;
+            float ev = dfs(new_aggressor, nxt_player, child_opp, child_own);
+            if (traverser)
+                evs[i] += opp_reach * ev;
+            total_ev += weight * ev;
 
             pot -= bet;
             curr_player.bet_made -= bet;
@@ -449,16 +535,269 @@ float Game::dfs(int last_aggressor, int player_turn) {
 
     // --- Undo dealt community cards ---
     while (undo_community_cards--) {
-        community_cards.pop_back();
-        top_card_index++;
+        community_cards &= ~card_mask(deck[++top_card_index]);
     }
 
     return total_ev;
 }
 
+/* Best response of main_character against the other player's current
+   strategy, over the GameState abstraction. The responder plays br_action,
+   one pure action per state; at each of its nodes every action is still
+   walked so br_values can collect its opp_reach-weighted value. Folding with
+   nothing to call is a check. The opponent's illegal actions are dropped and
+   the rest renormalised, as sample_action does. */
+float Game::best_response(int last_aggressor, int player_turn, float opp_reach,
+                          const uint8_t *br_action, ActionRow *br_values) {
+    if (all_folded()) {
+        Player &p = players[main_character];
+        return p.folded ? p.chips - INITIAL_CHIPS : p.chips + pot - INITIAL_CHIPS;
+    }
+    int undo_community_cards = 0;
+
+    if (last_aggressor == player_turn) {
+        if (community_cards == 0) {
+            for (int i = 0; i < 3; ++i)
+                community_cards |= card_mask(draw());
+            undo_community_cards = 3;
+        }
+        else if (num_cards(community_cards) < 5) {
+            community_cards |= card_mask(draw());
+            undo_community_cards = 1;
+        }
+        else {
+            return showdown();
+        }
+
+        player_turn = 0;
+        while (players[player_turn].folded) {
+            if (++player_turn >= NUM_PLAYERS) player_turn -= NUM_PLAYERS;
+        }
+        last_aggressor = player_turn;
+    }
+    if (last_aggressor == -1)
+        last_aggressor = player_turn;
+
+    Player &curr_player = players[player_turn];
+    int nxt_player = player_turn + 1 >= NUM_PLAYERS ? 0 : player_turn + 1;
+    int to_call = current_bet - curr_player.bet_made;
+    bool can_raise = pre_raises < 2 && post_raises < 2;
+
+    auto play = [&](int action, float child_reach) {
+        float ev;
+        if (action == FOLD && to_call > 0) {
+            curr_player.folded = true;
+            ev = best_response(last_aggressor, nxt_player, child_reach, br_action, br_values);
+            curr_player.folded = false;
+        }
+        else if (action == RAISE) {
+            bool preflop = community_cards == 0;
+            if (preflop) pre_raises++;
+            else post_raises++;
+            int bet = std::min(int((pot + to_call) * 0.5 + to_call), curr_player.chips);
+            pot += bet;
+            curr_player.bet_made += bet;
+            current_bet += bet - to_call;
+            curr_player.chips -= bet;
+
+            ev = best_response(player_turn, nxt_player, child_reach, br_action, br_values);
+
+            pot -= bet;
+            curr_player.bet_made -= bet;
+            current_bet -= bet - to_call;
+            curr_player.chips += bet;
+            if (preflop) pre_raises--;
+            else post_raises--;
+        }
+        else {
+            pot += to_call;
+            curr_player.bet_made += to_call;
+            curr_player.chips -= to_call;
+            ev = best_response(last_aggressor, nxt_player, child_reach, br_action, br_values);
+            pot -= to_call;
+            curr_player.bet_made -= to_call;
+            curr_player.chips += to_call;
+        }
+        return ev;
+    };
+
+    float value = 0.0f;
+    if (curr_player.folded) {
+        value = best_response(last_aggressor, nxt_player, opp_reach, br_action, br_values);
+    }
+    else {
+        int street = community_cards == 0 ? PREFLOP : num_cards(community_cards) - 2;
+        GameState state = deal_states[player_turn][street];
+        state.preflop_raises = pre_raises;
+        state.post_raises = post_raises;
+        int index = state_index(state);
+
+        if (player_turn == main_character) {
+            float evs[NUM_ACTIONS];
+            evs[CALL] = play(CALL, opp_reach);
+            evs[FOLD] = to_call > 0 ? play(FOLD, opp_reach) : evs[CALL];
+            evs[RAISE] = can_raise ? play(RAISE, opp_reach) : evs[CALL];
+            for (int i = 0; i < NUM_ACTIONS; ++i) br_values[index][i] += opp_reach * evs[i];
+            value = evs[br_action[index]];
+        }
+        else {
+            const ActionRow strategy = curr_player.seen[index] ? curr_player.strategy[index] : default_row(index);
+            float weights[NUM_ACTIONS] = {to_call > 0 ? strategy[FOLD] : 0.0f, strategy[CALL], can_raise ? strategy[RAISE] : 0.0f};
+            float total = weights[FOLD] + weights[CALL] + weights[RAISE];
+            if (total <= 0) {
+                weights[CALL] = 1.0f;
+                total = 1.0f;
+            }
+            for (int i = 0; i < NUM_ACTIONS; ++i) {
+                if (weights[i] <= 0) continue;
+                float weight = weights[i] / total;
+                value += weight * play(i, opp_reach * weight);
+            }
+        }
+    }
+
+    while (undo_community_cards--) {
+        community_cards &= ~card_mask(deck[++top_card_index]);
+    }
+    return value;
+}
+
+/* Expected chips per hand a best response in seat `player` wins. The
+   response is found by policy iteration on num_deals fixed deals: every pass
+   plays them with the current br_action, then switches each state to its
+   highest valued action. States merge histories and deals, so this settles on
+   a best response within the abstraction, usually in a few passes; it stops at
+   BEST_RESPONSE_PASSES regardless. */
+float Game::best_response_value(int player, int num_deals, int num_threads) {
+    const Player &p = players[player];
+    std::vector<uint8_t> br_action(NUM_GAMESTATES, CALL);
+    std::vector<uint8_t> raise_allowed(NUM_GAMESTATES);
+    for (int index = 0; index < NUM_GAMESTATES; ++index) {
+        GameState g = state_from_index(index);
+        raise_allowed[index] = g.preflop_raises < 2 && g.post_raises < 2;
+        if (!p.seen[index]) continue;
+        // start from what the player itself mostly does
+        const ActionRow &s = p.strategy[index];
+        int best = CALL;
+        if (s[FOLD] > s[best]) best = FOLD;
+        if (raise_allowed[index] && s[RAISE] > s[best]) best = RAISE;
+        br_action[index] = best;
+    }
+
+    std::vector<Game> workers(num_threads, *this);
+    std::vector<std::vector<ActionRow>> values(num_threads, std::vector<ActionRow>(NUM_GAMESTATES));
+    std::vector<double> totals(num_threads);
+    // mean value of br_action over deals first to first + num_deals - 1; deal
+    // d is the same cards whichever thread plays it
+    auto play_deals = [&](int first) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&, t]() {
+                Game &worker = workers[t];
+                worker.main_character = player;
+                std::fill(values[t].begin(), values[t].end(), ActionRow{});
+                totals[t] = 0;
+                for (int d = first + t; d < first + num_deals; d += num_threads) {
+                    worker.restart_deals(EXPLOITABILITY_SEED, d);
+                    totals[t] += worker.best_response(-1, 0, 1.0f, br_action.data(), values[t].data());
+                }
+            });
+        }
+        for (std::thread &thread: threads) thread.join();
+        double total = 0;
+        for (int t = 0; t < num_threads; ++t) total += totals[t];
+        return total / num_deals;
+    };
+
+    for (int pass = 0; pass < BEST_RESPONSE_PASSES; ++pass) {
+        play_deals(0);
+        bool changed = false;
+        for (int index = 0; index < NUM_GAMESTATES; ++index) {
+            ActionRow sum{};
+            for (int t = 0; t < num_threads; ++t) {
+                for (int i = 0; i < NUM_ACTIONS; ++i) sum[i] += values[t][index][i];
+            }
+            if (sum[FOLD] == 0 && sum[CALL] == 0 && sum[RAISE] == 0) continue;
+            int best = br_action[index];
+            for (int i = 0; i < NUM_ACTIONS; ++i) {
+                if (i == RAISE && !raise_allowed[index]) continue;
+                if (sum[i] > sum[best]) best = i;
+            }
+            if (best != br_action[index]) {
+                br_action[index] = best;
+                changed = true;
+            }
+        }
+        if (!changed) break;
+    }
+    // the response is fitted to its deals, and on them would overstate what it
+    // wins, so it is scored on a second set
+    double value = play_deals(num_deals);
+    return value;
+}
+
+// the game is zero-sum, so the two best responses average to how much the
+// current strategies lose to a worst-case opponent; in thousandths of a big blind
+float Game::exploitability(int num_deals, int num_threads) {
+    float chips = (best_response_value(0, num_deals, num_threads) + best_response_value(1, num_deals, num_threads)) / 2;
+    return chips * 1000 / (2 * small_blind);
+}
+
+#ifndef POKER_NO_MAIN
+int main(int argc, char **argv) {
+    int num_threads = 1;
+    bool external_sampling = false;
+    RegretUpdate regret_update = CFR_PLUS;
+    float exploitability_target = 0;
+    bool resume = false;
+    bool seeded = false;
+    uint64_t seed = 0;
+    std::string telemetry_file;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) num_threads = std::stoi(argv[++i]);
+        else if (arg == "--mccfr") external_sampling = true;
+        else if (arg == "--resume") resume = true;
+        else if (arg == "--telemetry" && i + 1 < argc) telemetry_file = argv[++i];
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+            seeded = true;
+        }
+        else if (arg == "--cfr" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "batch") regret_update = BATCH_REGRETS;
+            else if (mode == "plus") regret_update = CFR_PLUS;
+            else if (mode == "linear") regret_update = LINEAR_CFR;
+            else if (mode == "discounted") regret_update = DISCOUNTED_CFR;
+            else {
+                std::cerr << "unknown --cfr mode: " << mode << std::endl;
+                return 2;
+            }
+        }
+        else if (arg == "--target" && i + 1 < argc) exploitability_target = std::stof(argv[++i]);
+        else if (arg.rfind("--threads=", 0) == 0) num_threads = std::stoi(arg.substr(10));
+        else {
+            std::cerr << "usage: " << argv[0] << " [--threads N] [--mccfr] [--cfr batch|plus|linear|discounted] [--target MBB] [--seed S] [--resume] [--telemetry FILE]" << std::endl;
+            return 2;
+        }
+    }
+    if (num_threads < 1) num_threads = std::max(1u, std::thread::hardware_concurrency());
 
-int main() {
     Game game;
+    game.external_sampling = external_sampling;
+    game.regret_update = regret_update;
+    if (seeded) game.restart_deals(seed);
+    if (resume) {
+        uint64_t saved_seed;
+        if (!game.load_checkpoint(CHECKPOINT_FILE, saved_seed)) return 1;
+        game.restart_deals(saved_seed);
+    }
+    Telemetry telemetry;
+    if (!telemetry_file.empty()) {
+        if (!telemetry.open(telemetry_file)) return 1;
+        game.telemetry = &telemetry;
+    }
 
-    game.run_game();
+    game.run_game(num_threads, exploitability_target);
 }
+#endif
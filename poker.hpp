@@ -1,15 +1,26 @@
 #ifndef _POKER_HPP
 #define _POKER_HPP
 
-#include <map>
+#include <algorithm>
 #include <vector>
 #include <string>
-#include <fstream>
 
+#include "counter_rng.hpp"
+#include "evaluator.hpp"
+
+class Telemetry;
 
 #define NUM_PLAYERS 2
 #define INITIAL_CHIPS 200
 
+enum Street {
+    PREFLOP,
+    FLOP,
+    TURN,
+    RIVER,
+    NUM_STREETS
+};
+
 enum Suit : int {
     HEART,
     SPADE,
@@ -25,6 +36,10 @@ struct Card {
     std::string to_string() {
         return "[" + std::to_string(rank) + SUIT_NAME[suit] + "]";
     }
+
+    static Card from_index(int card) {
+        return {card_rank(card) + 2, static_cast<Suit>(card_suit(card))};
+    }
 };
 
 struct GameState {
@@ -40,6 +55,8 @@ struct GameState {
        straight_draw set to -1
        flush_draw = hole_cards are suited */ 
 
+    GameState() {}
+
     GameState(int r_combos, int flushes, int s_draws, bool f_draw, int pre_r, int post_r) 
     : rank_combos_that_beat_you(r_combos), flush_possible(flushes)
     , straight_draws(s_draws), flush_draw(f_draw), preflop_raises(pre_r), post_raises(post_r) {}
@@ -59,6 +76,42 @@ struct GameState {
     }
 };
 
+/* Dense GameState index: 169 starting hands x suited x preflop raises, then
+   rank combos (0-91) x flush possible x straight draws (0-3) x flush draw x
+   preflop raises x post raises. */
+#define PREFLOP_STATES (13 * 13 * 2 * 3)
+#define POSTFLOP_STATES (92 * 2 * 4 * 2 * 3 * 3)
+#define NUM_GAMESTATES (PREFLOP_STATES + POSTFLOP_STATES)
+
+inline int state_index(const GameState &g) {
+    if (g.straight_draws < 0) {
+        int hand = (g.rank_combos_that_beat_you - 2) * 13 + g.flush_possible - 2;
+        return (hand * 2 + g.flush_draw) * 3 + g.preflop_raises;
+    }
+    int index = g.rank_combos_that_beat_you;
+    index = index * 2 + g.flush_possible;
+    index = index * 4 + g.straight_draws;
+    index = index * 2 + g.flush_draw;
+    index = index * 3 + g.preflop_raises;
+    index = index * 3 + g.post_raises;
+    return PREFLOP_STATES + index;
+}
+
+inline GameState state_from_index(int index) {
+    if (index < PREFLOP_STATES) {
+        int pre_r = index % 3; index /= 3;
+        bool suited = index % 2; index /= 2;
+        return GameState(index / 13 + 2, index % 13 + 2, suited, pre_r);
+    }
+    index -= PREFLOP_STATES;
+    int post_r = index % 3; index /= 3;
+    int pre_r = index % 3; index /= 3;
+    bool f_draw = index % 2; index /= 2;
+    int s_draws = index % 4; index /= 4;
+    int flushes = index % 2; index /= 2;
+    return GameState(index, flushes, s_draws, f_draw, pre_r, post_r);
+}
+
 enum Action {
     FOLD,
     CALL,
@@ -66,53 +119,84 @@ enum Action {
     NUM_ACTIONS
 };
 
+// how update_strategy folds a batch's regrets into the cumulative ones
+enum RegretUpdate {
+    BATCH_REGRETS,
+    CFR_PLUS,
+    LINEAR_CFR,
+    DISCOUNTED_CFR
+};
+
+// per-action values of one GameState, padded so rows never straddle a cache line
+struct alignas(16) ActionRow {
+    float v[4];
+    float &operator[](int i) { return v[i]; }
+    const float &operator[](int i) const { return v[i]; }
+};
+
+// what the latest update_strategy call did to the main character's tables
+struct UpdateStats {
+    int states_touched;          // states the batch gave ev to
+    float strategy_change;       // L1 distance between the old and new strategies
+    float mean_positive_regret;  // summed over actions, averaged over the touched states
+};
+
+// an average row (Player::average) normalised, current before any averaging
+inline ActionRow normalized_average(const ActionRow &sum, const ActionRow &current) {
+    float total = sum[FOLD] + sum[CALL] + sum[RAISE];
+    if (total <= 0) return current;
+    return ActionRow{{sum[FOLD] / total, sum[CALL] / total, sum[RAISE] / total, 0.0f}};
+}
+
 struct Player {
     int chips;
-    Card hole_cards[2];
+    CardMask hole_cards;
     bool folded;
     int bet_made;
-    std::map<GameState, float[NUM_ACTIONS]> strategy;
-    std::map<GameState, float[NUM_ACTIONS]> ev;
-    Player() {}
-    Player(Card c1, Card c2) : chips(INITIAL_CHIPS), hole_cards{c1, c2}
-    , folded(false), bet_made(0) {}
+    // all indexed by state_index()
+    std::vector<ActionRow> strategy;
+    std::vector<ActionRow> ev;
+    std::vector<ActionRow> regret;   // cumulative, see Game::update_strategy
+    std::vector<ActionRow> average;  // reach-weighted sum of the strategies played
+    std::vector<uint8_t> seen;       // has a strategy, what the old map's keys were
+    std::vector<uint8_t> ev_touched; // has ev this update batch
+    std::vector<float> reach;        // own reach summed over this update batch
+    int iterations;                  // update_strategy calls so far
+    Player() : iterations(0) {}
+    Player(int c1, int c2) : chips(INITIAL_CHIPS), hole_cards(card_mask(c1) | card_mask(c2))
+    , folded(false), bet_made(0), strategy(NUM_GAMESTATES), ev(NUM_GAMESTATES)
+    , regret(NUM_GAMESTATES), average(NUM_GAMESTATES), seen(NUM_GAMESTATES)
+    , ev_touched(NUM_GAMESTATES), reach(NUM_GAMESTATES), iterations(0) {}
+
+    // the average strategy, normalised; the current one before any averaging
+    ActionRow average_strategy(int index) const { return normalized_average(average[index], strategy[index]); }
 
     std::string to_string() {
+        CardMask cards = hole_cards;
+        Card c1 = Card::from_index(pop_card(cards));
+        Card c2 = Card::from_index(pop_card(cards));
         return (
             "<Chips: " + std::to_string(chips) + " | Hole cards: " +
-            hole_cards[0].to_string() + hole_cards[1].to_string() + ">"
+            c1.to_string() + c2.to_string() + ">"
         );
     }
 
-    void save_strategy_to_file(const std::string &filename) {
-        std::ofstream file(filename);
-        if (!file.is_open()) {
-            std::cerr << "Failed to open file for writing: " << filename << std::endl;
-            return;
-        }
-        for (const auto &[g, probabilities]: strategy) {
-            file << g.rank_combos_that_beat_you << " " 
-                 << g.flush_possible << " "
-                 << g.straight_draws << " "
-                 << g.flush_draw << " "
-                 << g.preflop_raises << " "
-                 << g.post_raises << " |";
-            for (auto &p: probabilities) file << p << " ";
-            file << "|";
-            for (auto &p: ev[g]) file << p << " ";
-            file << '\n';
-        }
-        file.close();
-    }
+    // text: one "state |strategy |ev |average strategy" line per seen GameState
+    void save_strategy_to_file(const std::string &filename);
+    bool load_strategy_from_file(const std::string &filename);
+    // binary: strategy_file.hpp, HEADS_UP_LAYOUT; loading copies the tables
+    // out of the file, since they are what training writes
+    bool save_strategy_binary(const std::string &filename);
+    bool load_strategy_binary(const std::string &filename);
 
 };
 
 class Game {
 public:
     Player players[NUM_PLAYERS];
-    Card deck[52];
+    int deck[52];
     int top_card_index;
-    std::vector<Card> community_cards;
+    CardMask community_cards;
 
     int small_blind;
     int current_bet;
@@ -121,20 +205,61 @@ public:
     int post_raises;
 
     int main_character;
+    int updates; // update_strategy calls so far, kept across resumes
+    uint64_t traversal_allocations; // by run_traversals, see alloc_count.hpp
+    UpdateStats last_update;
+    // run_game records every update here when it is set
+    Telemetry *telemetry;
+    RegretUpdate regret_update;
+    CounterRng rng;
+    // external-sampling MCCFR: dfs samples the opponent's action instead of
+    // expanding them all
+    bool external_sampling;
+
+    /* card-dependent results for the current deal, filled by precompute_deal().
+       Raise counts in deal_states are 0, dfs patches in the live ones. */
+    GameState deal_states[NUM_PLAYERS][NUM_STREETS];
+    int showdown_scores[NUM_PLAYERS];
 
     Game();
 
-    Card draw();
+    int draw();
     bool all_folded();
-    void run_game();
-    GameState calc_gamestate(int player);
-    int evaluate_cards(int player);
+    // the state every traversal starts from
+    void post_blinds();
+    // num_threads > 1 splits every update's traversals over worker copies of
+    // this game; a positive exploitability_target (mbb/hand) can end training early
+    void run_game(int num_threads = 1, float exploitability_target = 0);
+    void run_traversals(int games);
+    void run_parallel_traversals(int games, int num_threads);
+    void merge_traversals(const Game &worker);
+    GameState calc_gamestate(int player, CardMask board);
+    int evaluate_cards(int player, CardMask board);
     float showdown();
-    void default_strategy(Player &p, const GameState &g);
+    void default_strategy(Player &p, int index);
+    int sample_action(const ActionRow &strategy, bool can_fold, bool can_raise);
     void update_strategy();
     void reset_and_deal();
+    void precompute_deal();
+
+    // rng reseeded, and a new hand dealt from a deck in its starting order
+    void restart_deals(uint64_t seed, uint64_t stream = 0);
+    /* Everything training carries from one update to the next: both players'
+       tables, updates, main_character and the settings, plus a seed that the
+       saving run and the resumed one both pass to restart_deals, so a resumed
+       run goes on exactly as the saved one did. */
+    bool save_checkpoint(const std::string &filename, uint64_t seed);
+    bool load_checkpoint(const std::string &filename, uint64_t &seed);
+
+    float dfs(int last_aggressor, int player_turn, float opp_reach = 1.0f, float own_reach = 1.0f);
 
-    float dfs(int last_aggressor, int player_turn);
+    // exploitability of the current strategies in mbb/hand, best responses
+    // fitted on num_deals fixed deals and scored on as many others; expects
+    // post_blinds() to have run, as run_game does
+    float exploitability(int num_deals, int num_threads = 1);
+    float best_response_value(int player, int num_deals, int num_threads);
+    float best_response(int last_aggressor, int player_turn, float opp_reach,
+                        const uint8_t *br_action, ActionRow *br_values);
 };
 
 #endif
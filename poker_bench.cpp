@@ -0,0 +1,173 @@
+// build with cmake (poker_bench target), or
+// g++ -std=c++17 -O2 -Wall -pthread -DPOKER_NO_MAIN poker_bench.cpp poker.cpp poker_strategy.cpp strategy_file.cpp evaluator.cpp equity.cpp isomorphism.cpp preflop.cpp alloc_count.cpp telemetry.cpp -o poker_bench
+// usage: ./poker_bench [seconds per benchmark]
+//
+// Times the hot paths of the evaluator, the equity engine and heads-up
+// training and prints one JSON object: for every benchmark the operations
+// timed, ns/op and ops/s. Inputs come from fixed seeds, so runs on one machine
+// can be compared over time.
+//
+// gto.cpp cannot be linked next to poker.cpp, so get_equities is measured
+// through the call that does its work, calculate_equities on gto's four
+// bucket ranges.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "equity.hpp"
+#include "evaluator.hpp"
+#include "isomorphism.hpp"
+#include "poker.hpp"
+#include "preflop.hpp"
+
+namespace {
+
+constexpr uint64_t BENCH_SEED = 12345;
+constexpr int NUM_HANDS = 1 << 16;
+
+// results feed this so the optimiser cannot drop the work being timed
+volatile long long sink;
+
+struct Result {
+    std::string name;
+    long long ops;
+    double seconds;
+};
+
+/* Calls run() until min_seconds of it have been timed, after one untimed
+   warm-up call. Each call does ops_per_call operations. setup() runs before
+   every call, outside the timed region. */
+template <typename Run, typename Setup>
+Result measure(const std::string &name, int ops_per_call, double min_seconds, Run run, Setup setup) {
+    setup();
+    run();
+    Result result = {name, 0, 0.0};
+    while (result.seconds < min_seconds) {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        result.seconds += elapsed.count();
+        result.ops += ops_per_call;
+    }
+    return result;
+}
+
+template <typename Run>
+Result measure(const std::string &name, int ops_per_call, double min_seconds, Run run) {
+    return measure(name, ops_per_call, min_seconds, run, [] {});
+}
+
+// n cards off the top of a shuffled deck without the dead ones
+CardMask deal_cards(CardMask dead, int n, CounterRng &rng) {
+    int cards[52];
+    int size = live_cards(dead, cards);
+    deal_to_top(cards, size, n, rng);
+    CardMask dealt = 0;
+    for (int i = 0; i < n; ++i) dealt |= card_mask(cards[size - 1 - i]);
+    return dealt;
+}
+
+void print_json(const std::vector<Result> &results) {
+    std::cout << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        std::cout << "    {\"name\": \"" << r.name << "\", \"ops\": " << r.ops
+                  << ", \"ns_per_op\": " << r.seconds * 1e9 / r.ops
+                  << ", \"ops_per_s\": " << r.ops / r.seconds << "}"
+                  << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ]\n}" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    double min_seconds = argc > 1 ? std::stod(argv[1]) : 0.5;
+    CounterRng rng(BENCH_SEED);
+    std::vector<Result> results;
+
+    std::vector<CardMask> hands(NUM_HANDS);
+    std::vector<int> scores(NUM_HANDS);
+    for (CardMask &hand: hands) hand = deal_cards(0, 7, rng);
+    results.push_back(measure("evaluate_hand", NUM_HANDS, min_seconds, [&] {
+        long long sum = 0;
+        for (CardMask hand: hands) sum += evaluate_hand(hand);
+        sink = sink + sum;
+    }));
+    results.push_back(measure("evaluate_hands", NUM_HANDS, min_seconds, [&] {
+        evaluate_hands(hands.data(), scores.data(), NUM_HANDS);
+        sink = sink + scores[NUM_HANDS - 1];
+    }));
+
+    // boards of 3 to 5 cards that miss player 0's hole cards
+    Game game;
+    game.restart_deals(BENCH_SEED);
+    std::vector<CardMask> boards(NUM_HANDS);
+    for (int i = 0; i < NUM_HANDS; ++i) boards[i] = deal_cards(game.players[0].hole_cards, 3 + i % 3, rng);
+    results.push_back(measure("evaluate_cards", NUM_HANDS, min_seconds, [&] {
+        long long sum = 0;
+        for (CardMask board: boards) sum += game.evaluate_cards(0, board);
+        sink = sink + sum;
+    }));
+    results.push_back(measure("calc_gamestate", NUM_HANDS, min_seconds, [&] {
+        long long sum = 0;
+        for (CardMask board: boards) sum += game.calc_gamestate(0, board).rank_combos_that_beat_you;
+        sink = sink + sum;
+    }));
+    results.push_back(measure("canonical_spot", NUM_HANDS, min_seconds, [&] {
+        CardMask sum = 0;
+        for (CardMask board: boards) sum += canonical_spot(game.players[0].hole_cards, board).hole;
+        sink = sink + sum;
+    }));
+
+    // both players' hands against the ranges gto.cpp's bucket_hands builds
+    std::vector<WeightedHand> buckets[NUM_BUCKETS];
+    int deck[52];
+    live_cards(0, deck);
+    for (int i = 0; i < 52; ++i) {
+        for (int j = i + 1; j < 52; ++j) {
+            WeightedHand hand = {card_mask(deck[i]) | card_mask(deck[j]), 1.0f};
+            buckets[hand_bucket(hand.cards)].push_back(hand);
+        }
+    }
+    const int equity_deals = 256;
+    std::vector<CardMask> flops(equity_deals), heroes(equity_deals * NUM_PLAYERS);
+    for (int d = 0; d < equity_deals; ++d) {
+        CardMask dealt = 0;
+        for (int h = 0; h < NUM_PLAYERS; ++h) {
+            heroes[d * NUM_PLAYERS + h] = deal_cards(dealt, 2, rng);
+            dealt |= heroes[d * NUM_PLAYERS + h];
+        }
+        flops[d] = deal_cards(dealt, 3, rng);
+    }
+    EquityResult equities[NUM_PLAYERS * NUM_BUCKETS];
+    int deal = 0;
+    results.push_back(measure("calculate_equities_flop", 1, min_seconds, [&] {
+        calculate_equities(&heroes[deal * NUM_PLAYERS], NUM_PLAYERS, flops[deal], buckets, NUM_BUCKETS,
+                           rng(), equities);
+        deal = (deal + 1) % equity_deals;
+        sink = sink + equities[0].samples;
+    }));
+
+    // one traversal from the root run_game starts every update from, plus the
+    // next deal, which is what run_traversals pays per game
+    game.post_blinds();
+    const int traversals = 1000;
+    results.push_back(measure("dfs", traversals, min_seconds, [&] {
+        game.run_traversals(traversals);
+    }));
+    // a pass over the tables one batch of traversals has just filled, as in
+    // training; every pass starts from the same copy of them
+    game.run_traversals(traversals);
+    const Player filled = game.players[game.main_character];
+    results.push_back(measure("update_strategy", 1, min_seconds, [&] {
+        game.update_strategy();
+    }, [&] {
+        game.players[game.main_character] = filled;
+    }));
+
+    print_json(results);
+}
@@ -0,0 +1,201 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "poker.hpp"
+#include "strategy_file.hpp"
+
+namespace {
+
+std::vector<StrategySection> heads_up_sections(const Player *p) {
+    return {
+        {p ? p->strategy.data() : nullptr, uint32_t(NUM_GAMESTATES), uint32_t(sizeof(ActionRow))},
+        {p ? p->ev.data() : nullptr, uint32_t(NUM_GAMESTATES), uint32_t(sizeof(ActionRow))},
+        {p ? p->seen.data() : nullptr, uint32_t(NUM_GAMESTATES), uint32_t(sizeof(uint8_t))},
+        {p ? p->regret.data() : nullptr, uint32_t(NUM_GAMESTATES), uint32_t(sizeof(ActionRow))},
+        {p ? p->average.data() : nullptr, uint32_t(NUM_GAMESTATES), uint32_t(sizeof(ActionRow))},
+    };
+}
+
+struct HeadsUpCheckpoint {
+    int32_t updates;
+    int32_t main_character;
+    int32_t regret_update;
+    int32_t external_sampling;
+    int32_t iterations[NUM_PLAYERS];
+    uint64_t seed;
+};
+
+// the meta row, then strategy, seen, regret and average of each player; ev,
+// ev_touched and reach are always empty between updates
+std::vector<StrategySection> checkpoint_sections(const HeadsUpCheckpoint *meta, const Game *game) {
+    std::vector<StrategySection> sections = {{meta, 1, uint32_t(sizeof(HeadsUpCheckpoint))}};
+    for (int i = 0; i < NUM_PLAYERS; ++i) {
+        const Player *p = game ? &game->players[i] : nullptr;
+        sections.push_back({p ? p->strategy.data() : nullptr, uint32_t(NUM_GAMESTATES), uint32_t(sizeof(ActionRow))});
+        sections.push_back({p ? p->seen.data() : nullptr, uint32_t(NUM_GAMESTATES), uint32_t(sizeof(uint8_t))});
+        sections.push_back({p ? p->regret.data() : nullptr, uint32_t(NUM_GAMESTATES), uint32_t(sizeof(ActionRow))});
+        sections.push_back({p ? p->average.data() : nullptr, uint32_t(NUM_GAMESTATES), uint32_t(sizeof(ActionRow))});
+    }
+    return sections;
+}
+
+bool valid_state(const GameState &g) {
+    if (g.preflop_raises < 0 || g.preflop_raises > 2) return false;
+    if (g.straight_draws == -1) {
+        return g.rank_combos_that_beat_you >= 2 && g.rank_combos_that_beat_you <= 14
+            && g.flush_possible >= 2 && g.flush_possible <= 14 && g.post_raises == 0;
+    }
+    return g.rank_combos_that_beat_you >= 0 && g.rank_combos_that_beat_you <= NUM_RANK_COMBOS
+        && g.flush_possible >= 0 && g.flush_possible <= 1
+        && g.straight_draws >= 0 && g.straight_draws <= 3
+        && g.post_raises >= 0 && g.post_raises <= 2;
+}
+
+// the tables the text format holds, in a Player or a mapped strategy file
+struct TextTables {
+    const ActionRow *strategy;
+    const ActionRow *ev;
+    const ActionRow *average;
+    const uint8_t *seen;
+};
+
+void write_strategy_text(const TextTables &t, const std::string &filename) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for writing: " << filename << std::endl;
+        return;
+    }
+    for (int index = 0; index < NUM_GAMESTATES; ++index) {
+        if (!t.seen[index]) continue;
+        GameState g = state_from_index(index);
+        file << g.rank_combos_that_beat_you << " "
+             << g.flush_possible << " "
+             << g.straight_draws << " "
+             << g.flush_draw << " "
+             << g.preflop_raises << " "
+             << g.post_raises << " |";
+        for (int i = 0; i < NUM_ACTIONS; ++i) file << t.strategy[index][i] << " ";
+        file << "|";
+        for (int i = 0; i < NUM_ACTIONS; ++i) file << t.ev[index][i] << " ";
+        file << "|";
+        ActionRow avg = normalized_average(t.average[index], t.strategy[index]);
+        for (int i = 0; i < NUM_ACTIONS; ++i) file << avg[i] << " ";
+        file << '\n';
+    }
+    file.close();
+}
+
+void size_tables(Player &p) {
+    p.strategy.assign(NUM_GAMESTATES, ActionRow{});
+    p.ev.assign(NUM_GAMESTATES, ActionRow{});
+    p.regret.assign(NUM_GAMESTATES, ActionRow{});
+    p.average.assign(NUM_GAMESTATES, ActionRow{});
+    p.seen.assign(NUM_GAMESTATES, 0);
+    p.ev_touched.assign(NUM_GAMESTATES, 0);
+    p.reach.assign(NUM_GAMESTATES, 0.0f);
+    p.iterations = 0;
+}
+
+} // namespace
+
+void Player::save_strategy_to_file(const std::string &filename) {
+    write_strategy_text({strategy.data(), ev.data(), average.data(), seen.data()}, filename);
+}
+
+bool Player::load_strategy_from_file(const std::string &filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return false;
+    }
+    size_tables(*this);
+
+    std::string line;
+    int skipped = 0;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        GameState g;
+        char bar1 = 0, bar2 = 0, bar3 = 0;
+        ActionRow s{}, e{}, a{};
+        iss >> g.rank_combos_that_beat_you >> g.flush_possible >> g.straight_draws >> g.flush_draw
+            >> g.preflop_raises >> g.post_raises >> bar1;
+        for (int i = 0; i < NUM_ACTIONS; ++i) iss >> s[i];
+        iss >> bar2;
+        for (int i = 0; i < NUM_ACTIONS; ++i) iss >> e[i];
+        if (!iss || bar1 != '|' || bar2 != '|' || !valid_state(g)) {
+            skipped++;
+            continue;
+        }
+        // the average column is optional, files written before it have none
+        bool has_average = bool(iss >> bar3) && bar3 == '|';
+        for (int i = 0; has_average && i < NUM_ACTIONS; ++i) iss >> a[i];
+        int index = state_index(g);
+        strategy[index] = s;
+        ev[index] = e;
+        if (has_average && iss) average[index] = a;
+        seen[index] = 1;
+    }
+    if (skipped) std::cerr << "Skipped " << skipped << " malformed rows in " << filename << std::endl;
+    return true;
+}
+
+bool Player::save_strategy_binary(const std::string &filename) {
+    return save_strategy_file(filename, HEADS_UP_LAYOUT, heads_up_sections(this));
+}
+
+bool Player::load_strategy_binary(const std::string &filename) {
+    MappedStrategyFile file;
+    if (!file.open(filename, HEADS_UP_LAYOUT, heads_up_sections(nullptr))) return false;
+    size_tables(*this);
+    std::memcpy(strategy.data(), file.section(0), NUM_GAMESTATES * sizeof(ActionRow));
+    std::memcpy(ev.data(), file.section(1), NUM_GAMESTATES * sizeof(ActionRow));
+    std::memcpy(seen.data(), file.section(2), NUM_GAMESTATES * sizeof(uint8_t));
+    std::memcpy(regret.data(), file.section(3), NUM_GAMESTATES * sizeof(ActionRow));
+    std::memcpy(average.data(), file.section(4), NUM_GAMESTATES * sizeof(ActionRow));
+    return true;
+}
+
+bool Game::save_checkpoint(const std::string &filename, uint64_t seed) {
+    HeadsUpCheckpoint meta = {updates, main_character, regret_update, external_sampling, {}, seed};
+    for (int i = 0; i < NUM_PLAYERS; ++i) meta.iterations[i] = players[i].iterations;
+    return save_strategy_file(filename, HEADS_UP_CHECKPOINT_LAYOUT, checkpoint_sections(&meta, this));
+}
+
+bool Game::load_checkpoint(const std::string &filename, uint64_t &seed) {
+    MappedStrategyFile file;
+    if (!file.open(filename, HEADS_UP_CHECKPOINT_LAYOUT, checkpoint_sections(nullptr, nullptr))) return false;
+    HeadsUpCheckpoint meta;
+    std::memcpy(&meta, file.section(0), sizeof(meta));
+    for (int i = 0; i < NUM_PLAYERS; ++i) {
+        Player &p = players[i];
+        size_tables(p);
+        std::memcpy(p.strategy.data(), file.section(1 + 4 * i), NUM_GAMESTATES * sizeof(ActionRow));
+        std::memcpy(p.seen.data(), file.section(2 + 4 * i), NUM_GAMESTATES * sizeof(uint8_t));
+        std::memcpy(p.regret.data(), file.section(3 + 4 * i), NUM_GAMESTATES * sizeof(ActionRow));
+        std::memcpy(p.average.data(), file.section(4 + 4 * i), NUM_GAMESTATES * sizeof(ActionRow));
+        p.iterations = meta.iterations[i];
+    }
+    updates = meta.updates;
+    main_character = meta.main_character;
+    regret_update = static_cast<RegretUpdate>(meta.regret_update);
+    external_sampling = meta.external_sampling;
+    seed = meta.seed;
+    return true;
+}
+
+bool heads_up_text_to_binary(const std::string &text_file, const std::string &binary_file) {
+    Player p;
+    return p.load_strategy_from_file(text_file) && p.save_strategy_binary(binary_file);
+}
+
+// straight from the mapping, nothing is copied
+bool heads_up_binary_to_text(const std::string &binary_file, const std::string &text_file) {
+    MappedStrategyFile file;
+    if (!file.open(binary_file, HEADS_UP_LAYOUT, heads_up_sections(nullptr))) return false;
+    write_strategy_text({static_cast<const ActionRow *>(file.section(0)), static_cast<const ActionRow *>(file.section(1)),
+                         static_cast<const ActionRow *>(file.section(4)), static_cast<const uint8_t *>(file.section(2))},
+                        text_file);
+    return true;
+}
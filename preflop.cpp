@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "preflop.hpp"
+
+namespace {
+
+struct PreflopHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t num_hands;
+    uint32_t num_buckets;
+};
+
+const char PREFLOP_MAGIC[4] = {'P', 'F', 'E', 'Q'};
+constexpr uint32_t PREFLOP_VERSION = 1;
+
+} // namespace
+
+int starting_hand(CardMask hole_cards) {
+    int c1 = pop_card(hole_cards);
+    int c2 = pop_card(hole_cards);
+    int high = std::max(card_rank(c1), card_rank(c2));
+    int low = std::min(card_rank(c1), card_rank(c2));
+    if (card_suit(c1) == card_suit(c2)) return high * 13 + low;
+    return low * 13 + high;
+}
+
+HandBucket hand_bucket(CardMask hole_cards) {
+    int c1 = pop_card(hole_cards);
+    int c2 = pop_card(hole_cards);
+    int high = std::max(card_rank(c1), card_rank(c2));
+    int low = std::min(card_rank(c1), card_rank(c2));
+    bool suited = card_suit(c1) == card_suit(c2);
+
+    if (low == high && low >= 9) return MONSTER_HANDS;
+    if (low >= 10 && high >= 12) return MONSTER_HANDS;
+    if (low >= 8 && high >= 8) return STRONG_HANDS;
+    if (low == high && low >= 5) return STRONG_HANDS;
+    if (high == 12 && suited) return STRONG_HANDS;
+    if (high - low == 1 && suited && low >= 3) return STRONG_HANDS;
+    if (high - low <= 1 || suited) return MEDIUM_HANDS;
+    return WEAK_HANDS;
+}
+
+bool save_preflop_equities(const std::string &filename, const PreflopEquities &equities) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for writing: " << filename << std::endl;
+        return false;
+    }
+    PreflopHeader header;
+    std::memcpy(header.magic, PREFLOP_MAGIC, sizeof(PREFLOP_MAGIC));
+    header.version = PREFLOP_VERSION;
+    header.num_hands = NUM_STARTING_HANDS;
+    header.num_buckets = NUM_BUCKETS;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(equities), sizeof(PreflopEquities));
+    return file.good();
+}
+
+bool load_preflop_equities(const std::string &filename, PreflopEquities &equities) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return false;
+    }
+    PreflopHeader header;
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, PREFLOP_MAGIC, sizeof(PREFLOP_MAGIC)) != 0
+        || header.version != PREFLOP_VERSION || header.num_hands != NUM_STARTING_HANDS
+        || header.num_buckets != NUM_BUCKETS) {
+        std::cerr << "Not a preflop equity table: " << filename << std::endl;
+        return false;
+    }
+    file.read(reinterpret_cast<char *>(equities), sizeof(PreflopEquities));
+    if (!file) {
+        std::cerr << "Truncated preflop equity table: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#ifndef _PREFLOP_HPP
+#define _PREFLOP_HPP
+
+#include <string>
+
+#include "cards.hpp"
+
+/* Starting-hand classes and the villain buckets used by gto.cpp, plus the
+   offline hero-vs-bucket preflop equity table (written by preflop_gen). */
+
+#define NUM_STARTING_HANDS 169
+#define PREFLOP_EQUITY_FILE "preflop_equity.bin"
+
+enum HandBucket {
+    MONSTER_HANDS,
+    STRONG_HANDS,
+    MEDIUM_HANDS,
+    WEAK_HANDS,
+    NUM_BUCKETS
+};
+
+typedef float PreflopEquities[NUM_STARTING_HANDS][NUM_BUCKETS];
+
+// 13x13 grid index: suited hands above the diagonal, offsuit below, pairs on it
+int starting_hand(CardMask hole_cards);
+HandBucket hand_bucket(CardMask hole_cards);
+
+bool save_preflop_equities(const std::string &filename, const PreflopEquities &equities);
+bool load_preflop_equities(const std::string &filename, PreflopEquities &equities);
+
+#endif
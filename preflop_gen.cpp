@@ -0,0 +1,154 @@
+// compile with g++ -std=c++17 -O2 -Wall -pthread preflop_gen.cpp preflop.cpp evaluator.cpp isomorphism.cpp -o preflop_gen
+// usage: ./preflop_gen [output file] [threads]
+//
+// Exact hero-vs-bucket preflop equities for the 169 starting hands. For every
+// board the 1081 live hands are scored and sorted once, and each hand's
+// wins/ties against each bucket are counted in O(1) by inclusion-exclusion over
+// its two cards. Boards are only visited once per suit-isomorphism class and
+// weighted by the size of that class.
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "evaluator.hpp"
+#include "isomorphism.hpp"
+#include "preflop.hpp"
+
+namespace {
+
+struct Accumulator {
+    double wins[NUM_STARTING_HANDS][NUM_BUCKETS] = {};
+    double matchups[NUM_STARTING_HANDS][NUM_BUCKETS] = {};
+};
+
+void score_board(CardMask board, int weight, const int (*hand_cards)[2], const CardMask *hand_masks,
+                 const int *hand_class, const int *hand_bkt, Accumulator &acc) {
+    // score << 32 | hand slot, so sorting orders by score
+    static thread_local uint64_t keys[1326];
+    static thread_local CardMask live[1326];
+    static thread_local int live_slot[1326], scores[1326];
+    int n = 0;
+    for (int h = 0; h < 1326; ++h) {
+        if (hand_masks[h] & board) continue;
+        live_slot[n] = h;
+        live[n++] = hand_masks[h];
+    }
+    evaluate_hands(live, board, scores, n);
+    for (int i = 0; i < n; ++i) keys[i] = uint64_t(scores[i]) << 32 | live_slot[i];
+    std::sort(keys, keys + n);
+
+    int total[NUM_BUCKETS] = {};
+    int total_card[NUM_BUCKETS][52] = {};
+    for (int i = 0; i < n; ++i) {
+        int h = keys[i] & 0xFFFFFFFF;
+        total[hand_bkt[h]]++;
+        total_card[hand_bkt[h]][hand_cards[h][0]]++;
+        total_card[hand_bkt[h]][hand_cards[h][1]]++;
+    }
+
+    int below[NUM_BUCKETS] = {};
+    int below_card[NUM_BUCKETS][52] = {};
+    int group_card[NUM_BUCKETS][52] = {};
+    for (int start = 0; start < n; ) {
+        int end = start;
+        while (end < n && (keys[end] >> 32) == (keys[start] >> 32)) ++end;
+
+        int group[NUM_BUCKETS] = {};
+        for (int i = start; i < end; ++i) {
+            int h = keys[i] & 0xFFFFFFFF;
+            group[hand_bkt[h]]++;
+            group_card[hand_bkt[h]][hand_cards[h][0]]++;
+            group_card[hand_bkt[h]][hand_cards[h][1]]++;
+        }
+        for (int i = start; i < end; ++i) {
+            int h = keys[i] & 0xFFFFFFFF;
+            int a = hand_cards[h][0], b = hand_cards[h][1];
+            for (int bkt = 0; bkt < NUM_BUCKETS; ++bkt) {
+                int self = hand_bkt[h] == bkt;
+                int wins = below[bkt] - below_card[bkt][a] - below_card[bkt][b];
+                int ties = group[bkt] - group_card[bkt][a] - group_card[bkt][b] + self;
+                int matchups = total[bkt] - total_card[bkt][a] - total_card[bkt][b] + self;
+                acc.wins[hand_class[h]][bkt] += weight * (wins + 0.5 * ties);
+                acc.matchups[hand_class[h]][bkt] += weight * double(matchups);
+            }
+        }
+        for (int i = start; i < end; ++i) {
+            int h = keys[i] & 0xFFFFFFFF;
+            group_card[hand_bkt[h]][hand_cards[h][0]]--;
+            group_card[hand_bkt[h]][hand_cards[h][1]]--;
+            below[hand_bkt[h]]++;
+            below_card[hand_bkt[h]][hand_cards[h][0]]++;
+            below_card[hand_bkt[h]][hand_cards[h][1]]++;
+        }
+        start = end;
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string filename = argc > 1 ? argv[1] : PREFLOP_EQUITY_FILE;
+    int num_threads = argc > 2 ? std::stoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+
+    int cards[52];
+    int num = 0;
+    for (int s = 0; s < 4; ++s)
+        for (int r = 0; r < 13; ++r) cards[num++] = card_index(r, s);
+
+    // hands are addressed by slot; cards inside a hand by their 0-51 position
+    static int hand_cards[1326][2];
+    static CardMask hand_masks[1326];
+    static int hand_class[1326], hand_bkt[1326];
+    int h = 0;
+    for (int i = 0; i < 52; ++i) {
+        for (int j = i + 1; j < 52; ++j) {
+            hand_cards[h][0] = i;
+            hand_cards[h][1] = j;
+            hand_masks[h] = card_mask(cards[i]) | card_mask(cards[j]);
+            hand_class[h] = starting_hand(hand_masks[h]);
+            hand_bkt[h] = hand_bucket(hand_masks[h]);
+            ++h;
+        }
+    }
+
+    std::vector<std::pair<CardMask, int>> boards;
+    for (int a = 0; a < 52; ++a)
+    for (int b = a + 1; b < 52; ++b)
+    for (int c = b + 1; c < 52; ++c)
+    for (int d = c + 1; d < 52; ++d)
+    for (int e = d + 1; e < 52; ++e) {
+        CardMask board = card_mask(cards[a]) | card_mask(cards[b]) | card_mask(cards[c])
+                       | card_mask(cards[d]) | card_mask(cards[e]);
+        int weight = canonical_weight(board);
+        if (weight) boards.push_back({board, weight});
+    }
+    std::cout << boards.size() << " canonical boards, " << num_threads << " threads" << std::endl;
+
+    std::vector<Accumulator> accumulators(num_threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (size_t i = t; i < boards.size(); i += num_threads) {
+                score_board(boards[i].first, boards[i].second, hand_cards, hand_masks,
+                            hand_class, hand_bkt, accumulators[t]);
+            }
+        });
+    }
+    for (std::thread &w: workers) w.join();
+
+    static PreflopEquities equities;
+    for (int c = 0; c < NUM_STARTING_HANDS; ++c) {
+        for (int bkt = 0; bkt < NUM_BUCKETS; ++bkt) {
+            double wins = 0, matchups = 0;
+            for (Accumulator &acc: accumulators) {
+                wins += acc.wins[c][bkt];
+                matchups += acc.matchups[c][bkt];
+            }
+            equities[c][bkt] = matchups > 0 ? wins / matchups : 0.5f;
+        }
+    }
+    if (!save_preflop_equities(filename, equities)) return 1;
+    std::cout << "wrote " << filename << std::endl;
+}
@@ -0,0 +1,31 @@
+// compile with g++ -std=c++17 -O2 -Wall strategy_convert.cpp strategy_file.cpp gto_strategy.cpp poker_strategy.cpp evaluator.cpp -o strategy_convert
+// usage: ./strategy_convert gto|heads-up <input> <output>
+//
+// Converts between the text strategy files (strategy.txt, p0_strat, p1_strat)
+// and the binary format of strategy_file.hpp. A binary input is written out as
+// text, anything else is parsed as text and written out as binary.
+
+#include <iostream>
+#include <string>
+
+#include "strategy_file.hpp"
+
+int main(int argc, char **argv) {
+    std::string game = argc > 1 ? argv[1] : "";
+    if (argc != 4 || (game != "gto" && game != "heads-up")) {
+        std::cerr << "usage: " << argv[0] << " gto|heads-up <input> <output>" << std::endl;
+        return 2;
+    }
+    std::string input = argv[2];
+    std::string output = argv[3];
+
+    bool ok;
+    if (is_strategy_file(input)) {
+        ok = game == "gto" ? gto_binary_to_text(input, output) : heads_up_binary_to_text(input, output);
+    }
+    else {
+        ok = game == "gto" ? gto_text_to_binary(input, output) : heads_up_text_to_binary(input, output);
+    }
+    if (!ok) return 1;
+    std::cout << "wrote " << output << std::endl;
+}
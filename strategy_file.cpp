@@ -0,0 +1,196 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "strategy_file.hpp"
+
+namespace {
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t layout;
+    uint32_t num_sections;
+    uint64_t checksum; // header (with this field 0) and section table
+};
+
+struct SectionEntry {
+    uint64_t offset;
+    uint64_t bytes;
+    uint32_t num_rows;
+    uint32_t row_bytes;
+    uint64_t checksum;
+};
+
+const char STRATEGY_MAGIC[4] = {'S', 'T', 'R', 'F'};
+constexpr uint64_t SECTION_ALIGN = 64;
+
+uint64_t align_up(uint64_t offset) {
+    return (offset + SECTION_ALIGN - 1) & ~(SECTION_ALIGN - 1);
+}
+
+// 64-bit FNV-1a
+uint64_t checksum(const void *data, size_t bytes, uint64_t hash = 0xCBF29CE484222325ULL) {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < bytes; ++i) {
+        hash ^= p[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+uint64_t table_checksum(FileHeader header, const SectionEntry *entries) {
+    header.checksum = 0;
+    return checksum(entries, header.num_sections * sizeof(SectionEntry), checksum(&header, sizeof(header)));
+}
+
+bool write_all(int fd, const void *data, size_t bytes) {
+    const char *p = static_cast<const char *>(data);
+    while (bytes) {
+        ssize_t n = ::write(fd, p, bytes);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+} // namespace
+
+bool save_strategy_file(const std::string &filename, StrategyLayout layout,
+                        const std::vector<StrategySection> &sections) {
+    FileHeader header;
+    std::memcpy(header.magic, STRATEGY_MAGIC, sizeof(STRATEGY_MAGIC));
+    header.version = STRATEGY_FILE_VERSION;
+    header.layout = layout;
+    header.num_sections = sections.size();
+
+    std::vector<SectionEntry> entries(sections.size());
+    uint64_t offset = align_up(sizeof(FileHeader) + entries.size() * sizeof(SectionEntry));
+    for (size_t i = 0; i < sections.size(); ++i) {
+        entries[i].offset = offset;
+        entries[i].bytes = uint64_t(sections[i].num_rows) * sections[i].row_bytes;
+        entries[i].num_rows = sections[i].num_rows;
+        entries[i].row_bytes = sections[i].row_bytes;
+        entries[i].checksum = checksum(sections[i].rows, entries[i].bytes);
+        offset = align_up(offset + entries[i].bytes);
+    }
+    header.checksum = table_checksum(header, entries.data());
+
+    // written beside the target and renamed over it once on disk, so a crash
+    // leaves either the old file or the new one
+    std::string temp = filename + ".tmp";
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open file for writing: " << temp << std::endl;
+        return false;
+    }
+    static const char padding[SECTION_ALIGN] = {};
+    bool ok = write_all(fd, &header, sizeof(header))
+           && write_all(fd, entries.data(), entries.size() * sizeof(SectionEntry));
+    uint64_t written = sizeof(header) + entries.size() * sizeof(SectionEntry);
+    for (size_t i = 0; ok && i < sections.size(); ++i) {
+        ok = write_all(fd, padding, entries[i].offset - written)
+          && write_all(fd, sections[i].rows, entries[i].bytes);
+        written = entries[i].offset + entries[i].bytes;
+    }
+    ok = ok && fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || std::rename(temp.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Failed to write file: " << filename << std::endl;
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool is_strategy_file(const std::string &filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[4];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, STRATEGY_MAGIC, sizeof(magic)) == 0;
+}
+
+int strategy_file_sections(const std::string &filename, StrategyLayout layout) {
+    std::ifstream file(filename, std::ios::binary);
+    FileHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))
+        || std::memcmp(header.magic, STRATEGY_MAGIC, sizeof(STRATEGY_MAGIC)) != 0
+        || header.version != STRATEGY_FILE_VERSION || header.layout != layout) {
+        std::cerr << "Not a matching strategy file: " << filename << std::endl;
+        return -1;
+    }
+    return header.num_sections;
+}
+
+bool MappedStrategyFile::open(const std::string &filename, StrategyLayout layout,
+                              const std::vector<StrategySection> &expected) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        size = st.st_size;
+        data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) data = nullptr;
+    }
+    ::close(fd);
+    if (!data) {
+        std::cerr << "Failed to map file: " << filename << std::endl;
+        size = 0;
+        return false;
+    }
+
+    const char *bytes = static_cast<const char *>(data);
+    const FileHeader *header = static_cast<const FileHeader *>(data);
+    const SectionEntry *entries = reinterpret_cast<const SectionEntry *>(bytes + sizeof(FileHeader));
+    if (size < sizeof(FileHeader) || std::memcmp(header->magic, STRATEGY_MAGIC, sizeof(STRATEGY_MAGIC)) != 0
+        || header->version != STRATEGY_FILE_VERSION || header->layout != layout
+        || header->num_sections != expected.size()
+        || size < sizeof(FileHeader) + expected.size() * sizeof(SectionEntry)) {
+        std::cerr << "Not a matching strategy file: " << filename << std::endl;
+        close();
+        return false;
+    }
+    if (table_checksum(*header, entries) != header->checksum) {
+        std::cerr << "Corrupt strategy file header: " << filename << std::endl;
+        close();
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); ++i) {
+        const SectionEntry &entry = entries[i];
+        if (entry.num_rows != expected[i].num_rows || entry.row_bytes != expected[i].row_bytes
+            || entry.bytes != uint64_t(entry.num_rows) * entry.row_bytes
+            || entry.offset % SECTION_ALIGN != 0 || entry.offset + entry.bytes > size) {
+            std::cerr << "Strategy file layout mismatch: " << filename << std::endl;
+            close();
+            return false;
+        }
+        if (checksum(bytes + entry.offset, entry.bytes) != entry.checksum) {
+            std::cerr << "Strategy file checksum mismatch: " << filename << std::endl;
+            close();
+            return false;
+        }
+        sections.push_back(bytes + entry.offset);
+    }
+    return true;
+}
+
+void MappedStrategyFile::close() {
+    if (data) munmap(data, size);
+    data = nullptr;
+    size = 0;
+    sections.clear();
+}
@@ -0,0 +1,69 @@
+#ifndef _STRATEGY_FILE_HPP
+#define _STRATEGY_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Versioned binary strategy files.
+
+   A file is a header, a section table and the sections. Each section is one
+   of a program's in-memory tables written byte for byte (rows x row size,
+   native endianness) on a 64-byte boundary, so the sections of a read-only
+   mmap of the file can stand in for the tables themselves. The header and
+   section table are covered by one checksum, every section by its own.
+   Files are replaced atomically: written to <name>.tmp, synced and renamed. */
+
+#define STRATEGY_FILE_VERSION 1
+
+enum StrategyLayout : uint32_t {
+    GTO_LAYOUT = 1,                // gto.cpp: StrategyRow per Gamestate
+    HEADS_UP_LAYOUT = 2,           // poker.cpp: strategy, ev, seen, regret and average per GameState
+    GTO_CHECKPOINT_LAYOUT = 3,     // gto.cpp: GtoCheckpoint, mutate flags, then a Strategy per player or member
+    HEADS_UP_CHECKPOINT_LAYOUT = 4 // poker.cpp: training state, see Game::save_checkpoint
+};
+
+struct StrategySection {
+    const void *rows;
+    uint32_t num_rows;
+    uint32_t row_bytes;
+};
+
+bool save_strategy_file(const std::string &filename, StrategyLayout layout,
+                        const std::vector<StrategySection> &sections);
+
+// true if the file starts with the strategy file magic
+bool is_strategy_file(const std::string &filename);
+// the number of sections a strategy file of this layout says it has, -1 if it
+// is not one; only the header is read, MappedStrategyFile::open checks the rest
+int strategy_file_sections(const std::string &filename, StrategyLayout layout);
+
+// read-only mapping of a strategy file
+class MappedStrategyFile {
+public:
+    MappedStrategyFile() {}
+    ~MappedStrategyFile() { close(); }
+    MappedStrategyFile(const MappedStrategyFile &) = delete;
+    MappedStrategyFile &operator=(const MappedStrategyFile &) = delete;
+
+    // checks the magic, version, layout, every checksum and that the sections
+    // have the shapes in expected (whose rows are ignored)
+    bool open(const std::string &filename, StrategyLayout layout, const std::vector<StrategySection> &expected);
+    void close();
+
+    const void *section(int i) const { return sections[i]; }
+
+private:
+    void *data = nullptr;
+    size_t size = 0;
+    std::vector<const void *> sections;
+};
+
+// text <-> binary for strategy_convert, defined next to each program's tables
+bool gto_text_to_binary(const std::string &text_file, const std::string &binary_file);
+bool gto_binary_to_text(const std::string &binary_file, const std::string &text_file);
+bool heads_up_text_to_binary(const std::string &text_file, const std::string &binary_file);
+bool heads_up_binary_to_text(const std::string &binary_file, const std::string &text_file);
+
+#endif
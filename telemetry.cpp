@@ -0,0 +1,74 @@
+#include <iostream>
+
+#include <unistd.h>
+
+#include "telemetry.hpp"
+
+namespace {
+
+// resident set size from /proc, 0 where there is none
+double resident_mb() {
+    std::ifstream statm("/proc/self/statm");
+    long pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) return 0;
+    return double(resident) * sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+} // namespace
+
+bool Telemetry::open(const std::string &filename) {
+    close();
+    file.open(filename, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for writing: " << filename << std::endl;
+        return false;
+    }
+    file.precision(10);
+    start = std::chrono::steady_clock::now();
+    closing = false;
+    writer = std::thread(&Telemetry::write_records, this);
+    return true;
+}
+
+void Telemetry::close() {
+    if (!is_open()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    queued.notify_one();
+    writer.join();
+    file.close();
+}
+
+void Telemetry::record(std::vector<TelemetryField> fields) {
+    if (!is_open()) return;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back({elapsed.count(), std::move(fields)});
+    }
+    queued.notify_one();
+}
+
+// takes the whole queue at once and writes it with the lock released
+void Telemetry::write_records() {
+    std::vector<Record> batch;
+    for (;;) {
+        bool done;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queued.wait(lock, [this] { return closing || !queue.empty(); });
+            batch.swap(queue);
+            done = closing;
+        }
+        for (const Record &r: batch) {
+            file << "{\"t\": " << r.seconds;
+            for (const TelemetryField &f: r.fields) file << ", \"" << f.name << "\": " << f.value;
+            file << ", \"rss_mb\": " << resident_mb() << "}\n";
+        }
+        file.flush();
+        batch.clear();
+        if (done) return;
+    }
+}
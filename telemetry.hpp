@@ -0,0 +1,57 @@
+#ifndef _TELEMETRY_HPP
+#define _TELEMETRY_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Training metrics as JSON lines, for gto.cpp and poker.cpp.
+
+   record() only timestamps the fields and queues them; a background thread
+   formats and writes the lines, so the training loop never waits on the file.
+   Each line is {"t": seconds since open, the fields in order, "rss_mb": the
+   resident memory when it was written}. */
+
+struct TelemetryField {
+    const char *name;
+    double value;
+};
+
+class Telemetry {
+public:
+    Telemetry() {}
+    ~Telemetry() { close(); }
+    Telemetry(const Telemetry &) = delete;
+    Telemetry &operator=(const Telemetry &) = delete;
+
+    // truncates filename and starts the writer
+    bool open(const std::string &filename);
+    // writes everything queued so far and stops the writer
+    void close();
+    bool is_open() const { return writer.joinable(); }
+
+    // nothing happens unless the stream is open
+    void record(std::vector<TelemetryField> fields);
+
+private:
+    struct Record {
+        double seconds;
+        std::vector<TelemetryField> fields;
+    };
+
+    void write_records();
+
+    std::ofstream file;
+    std::chrono::steady_clock::time_point start;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::vector<Record> queue; // guarded by mutex, as is closing
+    bool closing = false;
+};
+
+#endif